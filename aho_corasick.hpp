@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+/**
+ * Aho-Corasick multi-pattern scanner. \n
+ * \n
+ * Compiled from a PrefixTree whose keys are the patterns to look for: every node of the Trie becomes a
+ * state, and `Compile` adds the failure links (longest proper suffix that is also a path in the Trie)
+ * and output links (closest suffix state holding information). `Scan` then reports every occurrence of
+ * every pattern in a single linear pass over the text, independent of the number of patterns. \n
+ * Refer to: https://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_algorithm \n
+ * \n
+ * The scanner keeps its own copy of the information, so the Trie can change or go away after `Compile`.
+ * The empty key is not a pattern and is ignored.
+ * @tparam EdgeType Edge type of the Trie, i.e. the symbol type of the scanned text.
+ * @tparam NodeInfo Information reported for each match (e.g. a rule id).
+ */
+template <typename EdgeType, typename NodeInfo>
+class AhoCorasick
+{
+public:
+    /**
+     * Position of a scan inside a stream. \n
+     * \n
+     * Carry the same ScanState across consecutive `Scan` calls to process a stream chunk by chunk:
+     * matches spanning chunk boundaries are reported as if the stream had been scanned in one go.
+     */
+    struct ScanState
+    {
+        std::size_t m_state{};    // Current automaton state
+        std::size_t m_position{}; // Number of symbols consumed so far
+    };
+
+    /**
+     * Builds the automaton for all keys of `tree`. \n
+     * \n
+     * Runs in time linear in the number of nodes of the Trie (times a log factor for edge lookups).
+     * @param tree Trie holding the patterns.
+     * @return Scanner recognizing every key of `tree`.
+     */
+    template <typename Reducer>
+    static auto Compile(const PrefixTree<EdgeType, NodeInfo, Reducer>& tree) -> AhoCorasick
+    {
+        auto automaton = AhoCorasick{};
+
+        // Number states in BFS order, so the edges of each state are contiguous and sorted
+        using TrieNode = typename PrefixTree<EdgeType, NodeInfo, Reducer>::Node;
+        auto nodes = std::vector<const TrieNode*>{ tree.m_root.get() };
+        automaton.m_states.push_back(State{});
+        for (std::size_t id = 0; id < nodes.size(); ++id)
+        {
+            const auto& node = *nodes[id];
+            auto& state = automaton.m_states[id];
+            state.m_first_edge = automaton.m_edges.size();
+            if (node.m_info && id != 0)
+            {
+                state.m_info = automaton.m_infos.size();
+                automaton.m_infos.push_back(node.m_info.value());
+            }
+
+            const auto depth = state.m_depth;
+            for (const auto& [edge, child] : node.m_next)
+            {
+                automaton.m_edges.emplace_back(edge, nodes.size());
+                nodes.push_back(child.get());
+                auto child_state = State{};
+                child_state.m_depth = depth + 1;
+                automaton.m_states.push_back(child_state);
+            }
+            automaton.m_states[id].m_last_edge = automaton.m_edges.size();
+        }
+
+        // BFS order also guarantees that failure links point to already processed (shallower) states
+        for (std::size_t id = 0; id < automaton.m_states.size(); ++id)
+        {
+            const auto first = automaton.m_states[id].m_first_edge;
+            const auto last = automaton.m_states[id].m_last_edge;
+            for (auto index = first; index < last; ++index)
+            {
+                const auto& [edge, child] = automaton.m_edges[index];
+                auto& child_state = automaton.m_states[child];
+                if (id == 0)
+                {
+                    child_state.m_fail = 0;
+                }
+                else
+                {
+                    auto fallback = automaton.m_states[id].m_fail;
+                    auto next = automaton.Goto_(fallback, edge);
+                    while (next == kNone && fallback != 0)
+                    {
+                        fallback = automaton.m_states[fallback].m_fail;
+                        next = automaton.Goto_(fallback, edge);
+                    }
+                    child_state.m_fail = next == kNone ? 0 : next;
+                }
+
+                const auto& fail_state = automaton.m_states[child_state.m_fail];
+                child_state.m_output = fail_state.m_info != kNone ? child_state.m_fail : fail_state.m_output;
+            }
+        }
+        return automaton;
+    }
+
+    /**
+     * Scans a chunk of text, reporting every pattern occurrence that ends inside it. \n
+     * \n
+     * Matches are reported in order of their end position, longest pattern first.
+     * @param first Beginning of the chunk.
+     * @param last End of the chunk.
+     * @param state Scan position, updated to the end of the chunk.
+     * @param callback Called as `callback(std::size_t begin, std::size_t length, const NodeInfo&)`, where `begin`
+     * is the offset of the match from the start of the stream.
+     */
+    template <typename Iterator, typename Callback>
+    auto Scan(Iterator first, Iterator last, ScanState& state, Callback&& callback) const -> void
+    {
+        auto current = state.m_state;
+        auto position = state.m_position;
+        for (; first != last; ++first)
+        {
+            const auto& symbol = *first;
+            auto next = Goto_(current, symbol);
+            while (next == kNone && current != 0)
+            {
+                current = m_states[current].m_fail;
+                next = Goto_(current, symbol);
+            }
+            current = next == kNone ? 0 : next;
+            ++position;
+
+            auto match = m_states[current].m_info != kNone ? current : m_states[current].m_output;
+            while (match != kNone)
+            {
+                const auto& match_state = m_states[match];
+                callback(position - match_state.m_depth, match_state.m_depth, m_infos[match_state.m_info]);
+                match = match_state.m_output;
+            }
+        }
+        state.m_state = current;
+        state.m_position = position;
+    }
+
+    /**
+     * Scans a whole text in one go. Refer to the streaming overload.
+     */
+    template <typename Sequence, typename Callback>
+    auto Scan(const Sequence& text, Callback&& callback) const -> void
+    {
+        auto state = ScanState{};
+        Scan(std::begin(text), std::end(text), state, std::forward<Callback>(callback));
+    }
+
+    /**
+     * Returns the number of states of the automaton, which is the number of nodes of the compiled Trie.
+     */
+    auto StateCount() const -> std::size_t { return m_states.size(); }
+
+private:
+    static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+    struct State
+    {
+        std::size_t m_first_edge{};    // Edges of this state are m_edges[m_first_edge, m_last_edge)
+        std::size_t m_last_edge{};
+        std::size_t m_fail{};          // Failure link
+        std::size_t m_output{ kNone }; // Closest state along the failure links holding information
+        std::size_t m_info{ kNone };   // Index into m_infos, if this state ends a pattern
+        std::size_t m_depth{};         // Length of the pattern spelled by this state
+    };
+
+    AhoCorasick() = default;
+
+    /**
+     * Returns the state reached from `state` through `edge` in the Trie, or kNone.
+     */
+    auto Goto_(std::size_t state, const EdgeType& edge) const -> std::size_t
+    {
+        const auto first = m_edges.begin() + static_cast<std::ptrdiff_t>(m_states[state].m_first_edge);
+        const auto last = m_edges.begin() + static_cast<std::ptrdiff_t>(m_states[state].m_last_edge);
+        auto it = std::lower_bound(first, last, edge, [](const auto& entry, const EdgeType& value) {
+            return entry.first < value;
+        });
+        if (it == last || edge < it->first)
+            return kNone;
+        return it->second;
+    }
+
+private:
+    std::vector<State> m_states{};
+    std::vector<std::pair<EdgeType, std::size_t>> m_edges{}; // Trie edges, grouped by source state
+    std::vector<NodeInfo> m_infos{};
+};
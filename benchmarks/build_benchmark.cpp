@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../prefix_tree.hpp"
+
+// Speedup of PrefixTree::ParallelBuild over sequential inserts, from 1 to 32 threads.
+// Usage: build_benchmark [number of keys]
+
+namespace
+{
+    using Key = std::vector<int>;
+
+    constexpr std::size_t kKeyLength = 8;
+
+    auto MakeKeys(std::size_t count) -> std::vector<Key>
+    {
+        auto generator = std::mt19937{ 42 };
+        auto edge = std::uniform_int_distribution<int>{ 0, 255 };
+        auto keys = std::vector<Key>(count);
+        for (auto& key : keys)
+        {
+            key.resize(kKeyLength);
+            for (auto& value : key)
+                value = edge(generator);
+        }
+        return keys;
+    }
+
+    template <typename Build>
+    auto Seconds(Build&& build) -> double
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto tree = build();
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (tree.Empty())
+            std::printf("empty build\n");
+        return elapsed;
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const auto count = static_cast<std::size_t>(argc > 1 ? std::atol(argv[1]) : 1'000'000);
+    const auto keys = MakeKeys(count);
+    auto values = std::vector<int>(count);
+    for (std::size_t i = 0; i < count; ++i)
+        values[i] = static_cast<int>(i);
+
+    const auto sequential = Seconds([&] {
+        auto tree = PrefixTree<int, int>{};
+        for (std::size_t i = 0; i < count; ++i)
+            tree.Insert(keys[i], values[i]);
+        return tree;
+    });
+    std::printf("%-12s %12s %10s\n", "threads", "seconds", "speedup");
+    std::printf("%-12s %12.3f %10.2f\n", "sequential", sequential, 1.0);
+    for (std::size_t threads = 1; threads <= 32; threads *= 2)
+    {
+        const auto parallel = Seconds([&] { return PrefixTree<int, int>::ParallelBuild(keys, values, threads); });
+        std::printf("%-12zu %12.3f %10.2f\n", threads, parallel, sequential / parallel);
+    }
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../buffered_prefix_tree.hpp"
+#include "../concurrent_prefix_tree.hpp"
+#include "../lock_free_prefix_tree.hpp"
+#include "../olc_prefix_tree.hpp"
+
+// Throughput of concurrent Tries under mixed read/write workloads.
+// Usage: concurrent_benchmark [milliseconds per run]
+
+namespace
+{
+    using Key = std::vector<int>;
+
+    constexpr std::size_t kKeyCount = 100'000;
+    constexpr std::size_t kKeyLength = 4;
+
+    auto MakeKeys() -> std::vector<Key>
+    {
+        auto generator = std::mt19937{ 42 };
+        auto edge = std::uniform_int_distribution<int>{ 0, 255 };
+        auto keys = std::vector<Key>(kKeyCount);
+        for (auto& key : keys)
+        {
+            key.resize(kKeyLength);
+            for (auto& value : key)
+                value = edge(generator);
+        }
+        return keys;
+    }
+
+    // Baseline: a single PrefixTree behind one global mutex
+    class GlobalLockPrefixTree
+    {
+    public:
+        auto Insert(const Key& key, int info) -> void
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_tree.Insert(key, info);
+        }
+
+        auto Get(const Key& key) const -> tl::optional<int>
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            auto info = m_tree.Get(key);
+            if (!info)
+                return tl::nullopt;
+            return info.value();
+        }
+
+    private:
+        mutable std::mutex m_mutex{};
+        PrefixTree<int, int> m_tree{};
+    };
+
+    /**
+     * Runs `threads` threads doing `read_percent`% of Get and the rest Insert on random keys, for `duration`.
+     * Returns the number of operations per second.
+     */
+    template <typename Tree>
+    auto Run(Tree& tree, const std::vector<Key>& keys, std::size_t threads, unsigned read_percent,
+             std::chrono::milliseconds duration) -> double
+    {
+        auto stop = std::atomic<bool>{ false };
+        auto operations = std::atomic<std::size_t>{ 0 };
+        auto hits = std::atomic<std::size_t>{ 0 }; // Keeps the lookups from being optimized away
+        auto workers = std::vector<std::thread>{};
+        for (std::size_t id = 0; id < threads; ++id)
+        {
+            workers.emplace_back([&, id] {
+                auto generator = std::mt19937{ static_cast<unsigned>(id) };
+                auto pick = std::uniform_int_distribution<std::size_t>{ 0, keys.size() - 1 };
+                auto percent = std::uniform_int_distribution<unsigned>{ 0, 99 };
+                std::size_t done = 0;
+                std::size_t found = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    const auto& key = keys[pick(generator)];
+                    if (percent(generator) < read_percent)
+                        found += tree.Get(key).has_value() ? 1U : 0U;
+                    else
+                        tree.Insert(key, static_cast<int>(done));
+                    ++done;
+                }
+                operations += done;
+                hits += found;
+            });
+        }
+
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        for (auto& worker : workers)
+            worker.join();
+        return static_cast<double>(operations.load()) / std::chrono::duration<double>(duration).count();
+    }
+
+    template <typename Tree>
+    auto Preload(Tree& tree, const std::vector<Key>& keys) -> void
+    {
+        for (std::size_t i = 0; i < keys.size(); i += 2)
+            tree.Insert(keys[i], static_cast<int>(i));
+    }
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const auto duration = std::chrono::milliseconds{ argc > 1 ? std::atoi(argv[1]) : 200 };
+    const auto keys = MakeKeys();
+
+    std::printf("%-8s %-8s %16s %16s %16s %16s %16s\n", "reads", "threads", "global (op/s)", "sharded (op/s)",
+                "lock-free (op/s)", "olc (op/s)", "buffered (op/s)");
+    for (unsigned read_percent : { 95U, 50U })
+    {
+        for (std::size_t threads = 1; threads <= 64; threads *= 2)
+        {
+            auto global = GlobalLockPrefixTree{};
+            Preload(global, keys);
+            auto sharded = ConcurrentPrefixTree<int, int>{};
+            Preload(sharded, keys);
+            auto lock_free = LockFreePrefixTree<int, int>{};
+            Preload(lock_free, keys);
+            auto olc = OlcPrefixTree<int, int>{};
+            Preload(olc, keys);
+            auto buffered = BufferedPrefixTree<int, int>{};
+            Preload(buffered, keys);
+
+            const auto global_throughput = Run(global, keys, threads, read_percent, duration);
+            const auto sharded_throughput = Run(sharded, keys, threads, read_percent, duration);
+            const auto lock_free_throughput = Run(lock_free, keys, threads, read_percent, duration);
+            const auto olc_throughput = Run(olc, keys, threads, read_percent, duration);
+            const auto buffered_throughput = Run(buffered, keys, threads, read_percent, duration);
+            std::printf("%-8u %-8zu %16.0f %16.0f %16.0f %16.0f %16.0f\n", read_percent, threads, global_throughput,
+                        sharded_throughput, lock_free_throughput, olc_throughput, buffered_throughput);
+        }
+    }
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+/**
+ * Thread-safe PrefixTree front-end that buffers writes per thread. \n
+ * \n
+ * Every writer thread inserts into a small buffer Trie of its own, and only touches the shared Trie when its
+ * buffer reaches `threshold` keys, or on `Flush`: the buffer is then moved into the shared Trie with `Merge`,
+ * which relinks whole subtrees instead of copying them. Many small inserts thus cost one exclusive lock of the
+ * shared Trie per `threshold` keys, instead of one per key. \n
+ * A buffer is guarded by its own mutex, only contended while a reader or `Flush` visits it. \n
+ * Reads see the buffers and the shared Trie as a single Trie: the caller's buffer first, so a thread always
+ * reads its own writes, then the other buffers, then the shared Trie. A key inserted by several threads before
+ * being flushed may be read with the information of either, and keeps the one merged last. \n
+ * `Erase` is not buffered: it flushes every buffer and erases from the shared Trie.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree.
+ * @tparam Reducer Refer to PrefixTree.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer = NoReducer>
+class BufferedPrefixTree
+{
+public:
+    using Tree = PrefixTree<EdgeType, NodeInfo, Reducer>;
+    using Key = std::vector<EdgeType>;
+
+    /**
+     * Creates an empty Trie.
+     * @param threshold Number of keys a buffer holds before it is merged into the shared Trie.
+     * @param reducer Reducer of the shared Trie, and of the buffers.
+     */
+    explicit BufferedPrefixTree(std::size_t threshold = 1024, Reducer reducer = Reducer{})
+        : m_threshold{ threshold == 0 ? 1 : threshold }, m_reducer{ reducer }, m_tree{ std::move(reducer) },
+          m_id{ NextId_() }
+    {
+    }
+
+    BufferedPrefixTree(const BufferedPrefixTree&) = delete;
+    BufferedPrefixTree& operator=(const BufferedPrefixTree&) = delete;
+
+    /**
+     * Inserts or overwrites a key in the buffer of the calling thread. Refer to `PrefixTree::Insert`.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        auto& buffer = OwnBuffer_();
+        std::lock_guard<std::mutex> lock{ buffer.m_mutex };
+        buffer.m_tree.Insert(key, std::move(info));
+        buffer.m_size.store(buffer.m_tree.Size(), std::memory_order_release);
+        if (buffer.m_tree.Size() >= m_threshold)
+            FlushBuffer_(buffer);
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. Refer to the class comment for
+     * the order buffers are read in.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        auto own = FindOwnBuffer_();
+        if (own)
+        {
+            auto info = GetBuffered_(*own, key);
+            if (info)
+                return info;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock{ m_buffers_mutex };
+            for (const auto& buffer : m_buffers)
+            {
+                if (buffer.get() == own)
+                    continue;
+                auto info = GetBuffered_(*buffer, key);
+                if (info)
+                    return info;
+            }
+        }
+
+        // Checked last: a flush moves keys from a buffer to the shared Trie, never the other way
+        std::shared_lock<std::shared_mutex> lock{ m_tree_mutex };
+        auto info = m_tree.Get(key);
+        if (!info)
+            return tl::nullopt;
+        return info.value();
+    }
+
+    /**
+     * Returns true if `key` is present, buffered or not.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Flushes every buffer, then erases `key` from the shared Trie. Throws if it is not present.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        Flush();
+        std::unique_lock<std::shared_mutex> lock{ m_tree_mutex };
+        m_tree.Erase(key);
+    }
+
+    /**
+     * Merges every buffer into the shared Trie.
+     */
+    auto Flush() -> void
+    {
+        std::shared_lock<std::shared_mutex> buffers_lock{ m_buffers_mutex };
+        for (const auto& buffer : m_buffers)
+        {
+            std::lock_guard<std::mutex> lock{ buffer->m_mutex };
+            FlushBuffer_(*buffer);
+        }
+    }
+
+    /**
+     * Flushes every buffer, then calls `callback(const Tree&)` on the shared Trie under its shared lock, and
+     * returns its result. Lets queries such as `Match`, `TopK` or `Aggregate` run on every key.
+     */
+    template <typename Callback>
+    auto Read(Callback&& callback) -> decltype(auto)
+    {
+        Flush();
+        std::shared_lock<std::shared_mutex> lock{ m_tree_mutex };
+        return callback(static_cast<const Tree&>(m_tree));
+    }
+
+    /**
+     * Returns the number of keys. Exact right after `Flush`; keys buffered by several threads, or buffered and
+     * already in the shared Trie, are counted more than once.
+     */
+    auto Size() const -> std::size_t
+    {
+        std::size_t size = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock{ m_buffers_mutex };
+            for (const auto& buffer : m_buffers)
+                size += buffer->m_size.load(std::memory_order_acquire);
+        }
+        std::shared_lock<std::shared_mutex> lock{ m_tree_mutex };
+        return size + m_tree.Size();
+    }
+
+    /**
+     * Returns true if no key is buffered nor in the shared Trie.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+private:
+    // Aligned so that buffers of different threads do not share a cache line
+    struct alignas(64) Buffer
+    {
+        explicit Buffer(const Reducer& reducer) : m_tree{ reducer } {}
+
+        mutable std::mutex m_mutex{};
+        Tree m_tree;
+        std::atomic<std::size_t> m_size{}; // Keys in m_tree, readable without the lock
+    };
+
+    static auto NextId_() -> std::uint64_t
+    {
+        static std::atomic<std::uint64_t> next{ 0 };
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Buffers of the calling thread, by Trie id. Ids are never reused, so a destroyed Trie leaves a stale entry
+     * that is never looked up again.
+     */
+    static auto ThreadBuffers_() -> std::unordered_map<std::uint64_t, Buffer*>&
+    {
+        thread_local std::unordered_map<std::uint64_t, Buffer*> buffers{};
+        return buffers;
+    }
+
+    auto FindOwnBuffer_() const -> const Buffer*
+    {
+        const auto& buffers = ThreadBuffers_();
+        auto it = buffers.find(m_id);
+        return it == buffers.end() ? nullptr : it->second;
+    }
+
+    /**
+     * Returns the buffer of the calling thread, registering a new one on its first write.
+     */
+    auto OwnBuffer_() -> Buffer&
+    {
+        auto& buffers = ThreadBuffers_();
+        auto it = buffers.find(m_id);
+        if (it != buffers.end())
+            return *it->second;
+
+        auto buffer = std::make_unique<Buffer>(m_reducer);
+        auto& result = *buffer;
+        {
+            std::unique_lock<std::shared_mutex> lock{ m_buffers_mutex };
+            m_buffers.push_back(std::move(buffer));
+        }
+        buffers.emplace(m_id, &result);
+        return result;
+    }
+
+    static auto GetBuffered_(const Buffer& buffer, const Key& key) -> tl::optional<NodeInfo>
+    {
+        if (buffer.m_size.load(std::memory_order_acquire) == 0)
+            return tl::nullopt;
+        std::lock_guard<std::mutex> lock{ buffer.m_mutex };
+        auto info = buffer.m_tree.Get(key);
+        if (!info)
+            return tl::nullopt;
+        return info.value();
+    }
+
+    /**
+     * Moves the contents of `buffer` into the shared Trie. REQUIRES: the buffer mutex is held.
+     */
+    auto FlushBuffer_(Buffer& buffer) -> void
+    {
+        if (buffer.m_tree.Empty())
+            return;
+        {
+            std::unique_lock<std::shared_mutex> lock{ m_tree_mutex };
+            m_tree.Merge(std::move(buffer.m_tree));
+        }
+        buffer.m_size.store(0, std::memory_order_release);
+    }
+
+private:
+    std::size_t m_threshold;
+    Reducer m_reducer;
+    mutable std::shared_mutex m_tree_mutex{};
+    Tree m_tree;
+    mutable std::shared_mutex m_buffers_mutex{};
+    std::vector<std::unique_ptr<Buffer>> m_buffers{}; // One per thread that wrote, never removed
+    std::uint64_t m_id; // Identifies this Trie in the thread-local buffer maps
+};
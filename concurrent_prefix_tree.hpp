@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+/**
+ * Thread-safe PrefixTree, sharded by key prefix. \n
+ * \n
+ * Keys are spread over independent shards by a hash of their first `prefix_length` edges, and each shard is a
+ * plain PrefixTree guarded by its own std::shared_mutex. Readers of a shard share its lock, and writers only
+ * lock the shard their key falls in, so operations on different shards never contend. \n
+ * Keys sharing their first `prefix_length` edges live in the same shard, so prefix queries on such a prefix
+ * only need one shard. \n
+ * `Erase` leaves the nodes of erased keys in their shard. `CompactShards`, or an opt-in background compactor,
+ * replaces such shards with a compacted copy. The copy is built under the shared lock, so readers keep going,
+ * and swapped in under the exclusive lock only if no writer touched the shard meanwhile; the old nodes are
+ * then freed after releasing the lock.
+ * @tparam EdgeType Refer to PrefixTree. Must also be hashable with std::hash.
+ * @tparam NodeInfo Refer to PrefixTree.
+ * @tparam Reducer Refer to PrefixTree.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer = NoReducer>
+class ConcurrentPrefixTree
+{
+public:
+    using Tree = PrefixTree<EdgeType, NodeInfo, Reducer>;
+    using Key = std::vector<EdgeType>;
+
+    /**
+     * Creates an empty Trie.
+     * @param shards Number of shards. More shards mean less contention, at a small memory cost.
+     * @param prefix_length Number of leading edges hashed to pick a shard.
+     */
+    explicit ConcurrentPrefixTree(std::size_t shards = 64, std::size_t prefix_length = 1)
+        : m_shards{ std::make_unique<Shard[]>(shards == 0 ? 1 : shards) }, m_shard_count{ shards == 0 ? 1 : shards },
+          m_prefix_length{ prefix_length }
+    {
+    }
+
+    ConcurrentPrefixTree(const ConcurrentPrefixTree&) = delete;
+    ConcurrentPrefixTree& operator=(const ConcurrentPrefixTree&) = delete;
+
+    /**
+     * Stops the background compactor, if running.
+     */
+    ~ConcurrentPrefixTree() { StopCompactor(); }
+
+    /**
+     * Inserts or overwrites a key. Refer to `PrefixTree::Insert`.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        auto& shard = ShardOf_(key);
+        std::unique_lock<std::shared_mutex> lock{ shard.m_mutex };
+        const auto before = shard.m_tree.Size();
+        shard.m_tree.Insert(key, std::move(info));
+        ++shard.m_writes;
+        if (shard.m_tree.Size() != before)
+            m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. \n
+     * \n
+     * A copy is returned, as a reference would outlive the shard lock.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        const auto& shard = ShardOf_(key);
+        std::shared_lock<std::shared_mutex> lock{ shard.m_mutex };
+        auto info = shard.m_tree.Get(key);
+        if (!info)
+            return tl::nullopt;
+        return info.value();
+    }
+
+    /**
+     * Returns true if `key` is present.
+     */
+    auto Contains(const Key& key) const -> bool
+    {
+        const auto& shard = ShardOf_(key);
+        std::shared_lock<std::shared_mutex> lock{ shard.m_mutex };
+        return shard.m_tree.Contains(key);
+    }
+
+    /**
+     * Erases a key. Throws if it is not present. Refer to `PrefixTree::Erase`.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        auto& shard = ShardOf_(key);
+        std::unique_lock<std::shared_mutex> lock{ shard.m_mutex };
+        shard.m_tree.Erase(key);
+        ++shard.m_writes;
+        ++shard.m_erased;
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Calls `callback(const Tree&)` on the shard holding `prefix`, under its shared lock. \n
+     * \n
+     * Lets queries such as `Match`, `TopK` or `Aggregate` run on a consistent shard, as long as `prefix` has at
+     * least `prefix_length` edges, so every key starting with it is in that shard.
+     */
+    template <typename Callback>
+    auto ReadShard(const Key& prefix, Callback&& callback) const -> decltype(auto)
+    {
+        if (prefix.size() < m_prefix_length)
+            throw std::invalid_argument("Prefix is shorter than the shard prefix length");
+        const auto& shard = ShardOf_(prefix);
+        std::shared_lock<std::shared_mutex> lock{ shard.m_mutex };
+        return callback(shard.m_tree);
+    }
+
+    /**
+     * Returns the number of keys. Exact when no writer is running, a close approximation otherwise.
+     */
+    auto Size() const -> std::size_t { return m_size.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns true if the Trie holds no keys. Refer to `Size`.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+    /**
+     * Returns the number of shards.
+     */
+    auto ShardCount() const -> std::size_t { return m_shard_count; }
+
+    /**
+     * Compacts every shard with at least `min_erased` erases since its last compaction, on the calling thread.
+     * Refer to `PrefixTree::Compacted`. A shard written to while being compacted is left as it is.
+     * @return Number of shards compacted.
+     */
+    auto CompactShards(std::size_t min_erased = 1) -> std::size_t
+    {
+        std::size_t compacted = 0;
+        for (std::size_t i = 0; i < m_shard_count; ++i)
+        {
+            if (CompactShard_(m_shards[i], min_erased))
+                ++compacted;
+        }
+        return compacted;
+    }
+
+    /**
+     * Starts a background thread compacting cold shards every `period`. \n
+     * A shard is compacted once it has at least `min_erased` erases since its last compaction, and no write
+     * since the previous pass, so shards under churn are left alone until they settle.
+     */
+    auto StartCompactor(std::chrono::milliseconds period, std::size_t min_erased = 1024) -> void
+    {
+        StopCompactor();
+        m_compactor_stopping = false;
+        m_compactor = std::thread{ [this, period, min_erased] {
+            auto seen_writes = std::vector<std::uint64_t>(m_shard_count, 0);
+            std::unique_lock<std::mutex> lock{ m_compactor_mutex };
+            while (!m_compactor_wake.wait_for(lock, period, [this] { return m_compactor_stopping; }))
+            {
+                lock.unlock();
+                for (std::size_t i = 0; i < m_shard_count; ++i)
+                {
+                    const auto writes = Writes_(m_shards[i]);
+                    if (writes == seen_writes[i])
+                        CompactShard_(m_shards[i], min_erased);
+                    seen_writes[i] = writes;
+                }
+                lock.lock();
+            }
+        } };
+    }
+
+    /**
+     * Stops the background compactor, waiting for the current pass to finish. Does nothing if not running.
+     */
+    auto StopCompactor() -> void
+    {
+        if (!m_compactor.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock{ m_compactor_mutex };
+            m_compactor_stopping = true;
+        }
+        m_compactor_wake.notify_all();
+        m_compactor.join();
+    }
+
+private:
+    // Aligned so that locks of neighbouring shards do not share a cache line
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex m_mutex{};
+        Tree m_tree{};
+        std::uint64_t m_writes{}; // Inserts and erases, guarded by m_mutex
+        std::size_t m_erased{};   // Erases since the last compaction, guarded by m_mutex
+    };
+
+    static auto Writes_(const Shard& shard) -> std::uint64_t
+    {
+        std::shared_lock<std::shared_mutex> lock{ shard.m_mutex };
+        return shard.m_writes;
+    }
+
+    /**
+     * Replaces the Trie of `shard` with a compacted copy. Refer to the class comment.
+     * @return True if the shard was compacted.
+     */
+    static auto CompactShard_(Shard& shard, std::size_t min_erased) -> bool
+    {
+        auto compacted = Tree{};
+        std::uint64_t writes = 0;
+        {
+            std::shared_lock<std::shared_mutex> lock{ shard.m_mutex };
+            if (shard.m_erased == 0 || shard.m_erased < min_erased)
+                return false;
+            writes = shard.m_writes;
+            compacted = shard.m_tree.Compacted();
+        }
+
+        // Swapped out, so that the old nodes are freed once the lock is released
+        {
+            std::unique_lock<std::shared_mutex> lock{ shard.m_mutex };
+            if (shard.m_writes != writes)
+                return false;
+            std::swap(shard.m_tree, compacted);
+            shard.m_erased = 0;
+        }
+        return true;
+    }
+
+    auto ShardIndex_(const Key& key) const -> std::size_t
+    {
+        const auto length = std::min(key.size(), m_prefix_length);
+        std::size_t hash = length;
+        for (std::size_t i = 0; i < length; ++i)
+            hash ^= std::hash<EdgeType>{}(key[i]) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        return hash % m_shard_count;
+    }
+
+    auto ShardOf_(const Key& key) -> Shard& { return m_shards[ShardIndex_(key)]; }
+    auto ShardOf_(const Key& key) const -> const Shard& { return m_shards[ShardIndex_(key)]; }
+
+private:
+    std::unique_ptr<Shard[]> m_shards;
+    std::size_t m_shard_count;
+    std::size_t m_prefix_length;
+    std::atomic<std::size_t> m_size{};
+
+    std::thread m_compactor{};
+    std::mutex m_compactor_mutex{};
+    std::condition_variable m_compactor_wake{};
+    bool m_compactor_stopping{};
+};
@@ -0,0 +1,802 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "tl_optional.hpp"
+
+/**
+ * Concurrent hash trie (Ctrie) with lock-free Insert, Get and Erase, and constant-time snapshots. \n
+ * \n
+ * Keys are hashed, and the hash is consumed `kBits` bits per level. Every level is an indirection node (INode)
+ * pointing to an immutable main node: a bitmap-compressed array of branches (CNode), a tombstone (TNode) left
+ * by an erase that must be compressed into its parent, or a list of keys whose hashes fully collide (LNode).
+ * Writers build a new main node and swap it in with a single CAS on the INode, so they never lock. \n
+ * Every INode belongs to a generation. `Snapshot` swaps the root for a new INode of a new generation, with a
+ * double-compare single-swap (RDCSS) that only succeeds if the root main node did not change. From then on,
+ * writers lazily copy the INodes they walk through into the new generation, and a CAS on an INode of an old
+ * generation only commits (GCAS) if the root generation is still that INode's. The snapshot thus keeps the old
+ * root, and reads a structure nobody modifies anymore. \n
+ * Refer to: Prokopec et al., "Concurrent Tries with Efficient Non-Blocking Snapshots" (2012). \n
+ * \n
+ * Nodes are shared between generations and freed by reference counting (std::shared_ptr, accessed with its
+ * atomic free functions). \n
+ * Being a hash trie, it does not keep keys sorted nor supports prefix queries: it targets point operations and
+ * full scans, such as backups or analytics, that need a stable view while writers keep going.
+ * @tparam EdgeType Refer to PrefixTree. Must also be hashable with std::hash.
+ * @tparam NodeInfo Refer to PrefixTree. Lookups return copies of it.
+ */
+template <typename EdgeType, typename NodeInfo>
+class CtriePrefixTree
+{
+public:
+    using Key = std::vector<EdgeType>;
+
+private:
+    enum class Kind_
+    {
+        INode,
+        SNode,
+        CNode,
+        TNode,
+        LNode,
+        Failed,
+        Descriptor
+    };
+
+    struct Object_
+    {
+        explicit Object_(Kind_ kind) : m_kind{ kind } {}
+        virtual ~Object_() = default;
+        Object_(const Object_&) = delete;
+        Object_& operator=(const Object_&) = delete;
+
+        const Kind_ m_kind;
+    };
+
+    using Branch_ = std::shared_ptr<Object_>; // An INode_ or an SNode_
+
+    struct Generation_
+    {
+    };
+    using GenerationPtr_ = std::shared_ptr<const Generation_>;
+
+    // A key and its information. Immutable.
+    struct SNode_ : Object_
+    {
+        SNode_(Key key, NodeInfo info, std::uint64_t hash)
+            : Object_{ Kind_::SNode }, m_key{ std::move(key) }, m_info{ std::move(info) }, m_hash{ hash }
+        {
+        }
+
+        Key m_key;
+        NodeInfo m_info;
+        std::uint64_t m_hash;
+    };
+
+    struct MainNode_ : Object_
+    {
+        using Object_::Object_;
+
+        // Accessed atomically. nullptr once the node is committed, the main node it replaces while its GCAS is
+        // pending, or a Failed_ node once that GCAS is aborted.
+        std::shared_ptr<MainNode_> m_prev{};
+    };
+
+    struct CNode_ : MainNode_
+    {
+        CNode_(std::uint64_t bitmap, std::vector<Branch_> array, GenerationPtr_ generation)
+            : MainNode_{ Kind_::CNode }, m_bitmap{ bitmap }, m_array{ std::move(array) },
+              m_generation{ std::move(generation) }
+        {
+        }
+
+        std::uint64_t m_bitmap;        // Bit i is set if a branch continues with hash bits i
+        std::vector<Branch_> m_array;  // One branch per bit set, in bit order
+        GenerationPtr_ m_generation;
+    };
+
+    struct TNode_ : MainNode_
+    {
+        explicit TNode_(std::shared_ptr<SNode_> entry) : MainNode_{ Kind_::TNode }, m_entry{ std::move(entry) } {}
+
+        std::shared_ptr<SNode_> m_entry; // The only key left below, to be moved up into the parent
+    };
+
+    struct LNode_ : MainNode_
+    {
+        explicit LNode_(std::vector<std::shared_ptr<SNode_>> entries)
+            : MainNode_{ Kind_::LNode }, m_entries{ std::move(entries) }
+        {
+        }
+
+        std::vector<std::shared_ptr<SNode_>> m_entries;
+    };
+
+    // Marks an aborted GCAS. Its m_prev is the main node to restore.
+    struct Failed_ : MainNode_
+    {
+        explicit Failed_(std::shared_ptr<MainNode_> restored) : MainNode_{ Kind_::Failed }
+        {
+            this->m_prev = std::move(restored);
+        }
+    };
+
+    struct INode_ : Object_
+    {
+        INode_(std::shared_ptr<MainNode_> main, GenerationPtr_ generation)
+            : Object_{ Kind_::INode }, m_main{ std::move(main) }, m_generation{ std::move(generation) }
+        {
+        }
+
+        std::shared_ptr<MainNode_> m_main; // Accessed atomically
+        GenerationPtr_ m_generation;
+    };
+
+    // Pending RDCSS on the root: replace `m_old` by `m_new` if the main node of `m_old` is still `m_expected`
+    struct Descriptor_ : Object_
+    {
+        Descriptor_(std::shared_ptr<INode_> old, std::shared_ptr<MainNode_> expected, std::shared_ptr<INode_> next)
+            : Object_{ Kind_::Descriptor }, m_old{ std::move(old) }, m_expected{ std::move(expected) },
+              m_new{ std::move(next) }
+        {
+        }
+
+        std::shared_ptr<INode_> m_old;
+        std::shared_ptr<MainNode_> m_expected;
+        std::shared_ptr<INode_> m_new;
+        std::atomic<bool> m_committed{ false };
+    };
+
+    enum class Status_
+    {
+        Found,
+        NotFound,
+        Restart
+    };
+
+public:
+    /**
+     * Read-only, consistent view of the Trie at the time `Snapshot` was called. Cheap to copy, and unaffected
+     * by later writes. Safe to read from several threads.
+     */
+    class View
+    {
+    public:
+        /**
+         * Returns a copy of the information associated with `key` in the snapshot, or tl::nullopt.
+         */
+        auto Get(const Key& key) const -> tl::optional<NodeInfo>
+        {
+            std::shared_ptr<SNode_> found;
+            if (Lookup_(m_root, key, Hash_(key), 0, nullptr, nullptr, nullptr, found) != Status_::Found)
+                return tl::nullopt;
+            return found->m_info;
+        }
+
+        /**
+         * Returns true if `key` was present when the snapshot was taken.
+         */
+        auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+        /**
+         * Calls `callback(const Key&, const NodeInfo&)` on every key of the snapshot, in no particular order.
+         */
+        template <typename Callback>
+        auto ForEach(Callback&& callback) const -> void
+        {
+            ForEach_(*m_root, callback);
+        }
+
+        /**
+         * Returns the number of keys of the snapshot. Linear: it counts them.
+         */
+        auto Size() const -> std::size_t
+        {
+            std::size_t size = 0;
+            ForEach([&size](const Key&, const NodeInfo&) { ++size; });
+            return size;
+        }
+
+    private:
+        friend class CtriePrefixTree;
+        explicit View(std::shared_ptr<INode_> root) : m_root{ std::move(root) } {}
+
+        template <typename Callback>
+        static auto ForEach_(INode_& node, Callback& callback) -> void
+        {
+            auto main = GcasRead_(node, nullptr);
+            if (main->m_kind == Kind_::TNode)
+            {
+                const auto& entry = *static_cast<const TNode_&>(*main).m_entry;
+                callback(entry.m_key, entry.m_info);
+            }
+            else if (main->m_kind == Kind_::LNode)
+            {
+                for (const auto& entry : static_cast<const LNode_&>(*main).m_entries)
+                    callback(entry->m_key, entry->m_info);
+            }
+            else
+            {
+                for (const auto& branch : static_cast<const CNode_&>(*main).m_array)
+                {
+                    if (branch->m_kind == Kind_::INode)
+                        ForEach_(static_cast<INode_&>(*branch), callback);
+                    else
+                    {
+                        const auto& entry = static_cast<const SNode_&>(*branch);
+                        callback(entry.m_key, entry.m_info);
+                    }
+                }
+            }
+        }
+
+        std::shared_ptr<INode_> m_root;
+    };
+
+    CtriePrefixTree()
+    {
+        auto generation = std::make_shared<const Generation_>();
+        m_root = std::make_shared<INode_>(std::make_shared<CNode_>(0, std::vector<Branch_>{}, generation),
+                                          generation);
+    }
+
+    CtriePrefixTree(const CtriePrefixTree&) = delete;
+    CtriePrefixTree& operator=(const CtriePrefixTree&) = delete;
+
+    /**
+     * Inserts or overwrites a key. Refer to `PrefixTree::Insert`. Lock-free.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        auto entry = std::make_shared<SNode_>(key, std::move(info), Hash_(key));
+        while (true)
+        {
+            auto root = ReadRoot_();
+            auto added = false;
+            if (Insert_(root, entry, 0, nullptr, root->m_generation, added))
+            {
+                if (added)
+                    m_size.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. Lock-free.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        const auto hash = Hash_(key);
+        while (true)
+        {
+            auto root = ReadRoot_();
+            std::shared_ptr<SNode_> found;
+            const auto status = Lookup_(root, key, hash, 0, nullptr, root->m_generation, this, found);
+            if (status == Status_::Found)
+                return found->m_info;
+            if (status == Status_::NotFound)
+                return tl::nullopt;
+        }
+    }
+
+    /**
+     * Returns true if `key` is present. Lock-free.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Erases a key. Throws if it is not present. Lock-free.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        const auto hash = Hash_(key);
+        while (true)
+        {
+            auto root = ReadRoot_();
+            std::shared_ptr<SNode_> removed;
+            const auto status = Remove_(root, key, hash, 0, nullptr, root->m_generation, removed);
+            if (status == Status_::NotFound)
+                throw std::runtime_error("Erasing key not present in Trie");
+            if (status == Status_::Found)
+            {
+                m_size.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Takes a consistent, read-only snapshot of the Trie, in constant time and without blocking writers.
+     */
+    auto Snapshot() const -> View
+    {
+        while (true)
+        {
+            auto root = ReadRoot_();
+            auto main = GcasRead_(*root, this);
+            auto next = std::make_shared<INode_>(main, std::make_shared<const Generation_>());
+            if (RdcssRoot_(root, main, std::move(next)))
+                return View{ std::move(root) };
+        }
+    }
+
+    /**
+     * Returns the number of keys. Exact when no writer is running, a close approximation otherwise.
+     */
+    auto Size() const -> std::size_t { return m_size.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns true if the Trie holds no keys. Refer to `Size`.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+private:
+    static constexpr unsigned kBits = 6; // Hash bits consumed per level, so a CNode has up to 64 branches
+    static constexpr unsigned kHashBits = 64;
+    static constexpr std::uint64_t kMask = (std::uint64_t{ 1 } << kBits) - 1;
+
+    static auto Hash_(const Key& key) -> std::uint64_t
+    {
+        std::uint64_t hash = key.size();
+        for (const auto& edge_value : key)
+            hash ^= std::hash<EdgeType>{}(edge_value) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        // Finalizer, so that every level sees well-mixed bits even if std::hash is the identity
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    /**
+     * Returns the bit of `hash` at `level` in a CNode bitmap, and the position of its branch in the array.
+     */
+    static auto FlagPosition_(std::uint64_t hash, unsigned level, std::uint64_t bitmap)
+        -> std::pair<std::uint64_t, std::size_t>
+    {
+        const auto flag = std::uint64_t{ 1 } << ((hash >> level) & kMask);
+        return { flag, std::bitset<64>{ bitmap & (flag - 1) }.count() };
+    }
+
+    template <typename Node>
+    static auto Cast_(const std::shared_ptr<Object_>& object) -> std::shared_ptr<Node>
+    {
+        return std::static_pointer_cast<Node>(object);
+    }
+
+    // GCAS
+
+    /**
+     * Returns the committed main node of `node`, completing or aborting its pending GCAS, if any.
+     * @param tree The Trie `node` belongs to, or nullptr for a read-only snapshot, which aborts pending GCASes.
+     */
+    static auto GcasRead_(INode_& node, const CtriePrefixTree* tree) -> std::shared_ptr<MainNode_>
+    {
+        auto main = std::atomic_load(&node.m_main);
+        if (!std::atomic_load(&main->m_prev))
+            return main;
+        return GcasCommit_(node, std::move(main), tree);
+    }
+
+    static auto GcasCommit_(INode_& node, std::shared_ptr<MainNode_> main, const CtriePrefixTree* tree)
+        -> std::shared_ptr<MainNode_>
+    {
+        while (true)
+        {
+            auto prev = std::atomic_load(&main->m_prev);
+            if (!prev)
+                return main;
+
+            if (prev->m_kind == Kind_::Failed)
+            {
+                auto restored = std::atomic_load(&prev->m_prev);
+                auto expected = main;
+                if (std::atomic_compare_exchange_strong(&node.m_main, &expected, restored))
+                    return restored;
+                main = std::atomic_load(&node.m_main);
+                continue;
+            }
+
+            // Commit only if no snapshot was taken since the GCAS started, i.e. the root generation is unchanged
+            if (tree && tree->ReadRoot_(true)->m_generation == node.m_generation)
+            {
+                auto expected = prev;
+                if (std::atomic_compare_exchange_strong(&main->m_prev, &expected, std::shared_ptr<MainNode_>{}))
+                    return main;
+                continue;
+            }
+
+            auto expected = prev;
+            std::shared_ptr<MainNode_> failed = std::make_shared<Failed_>(prev);
+            std::atomic_compare_exchange_strong(&main->m_prev, &expected, failed);
+            main = std::atomic_load(&node.m_main);
+        }
+    }
+
+    /**
+     * Replaces the main node of `node` by `replacement` if it is still `old` and the root generation did not
+     * change. Returns true on success.
+     */
+    auto Gcas_(INode_& node, const std::shared_ptr<MainNode_>& old,
+               const std::shared_ptr<MainNode_>& replacement) const -> bool
+    {
+        std::atomic_store(&replacement->m_prev, old);
+        auto expected = old;
+        if (!std::atomic_compare_exchange_strong(&node.m_main, &expected, replacement))
+            return false;
+        GcasCommit_(node, replacement, this);
+        return !std::atomic_load(&replacement->m_prev);
+    }
+
+    // RDCSS on the root
+
+    auto ReadRoot_(bool abort = false) const -> std::shared_ptr<INode_>
+    {
+        auto root = std::atomic_load(&m_root);
+        if (root->m_kind == Kind_::INode)
+            return Cast_<INode_>(root);
+        return CompleteRoot_(abort);
+    }
+
+    auto CompleteRoot_(bool abort) const -> std::shared_ptr<INode_>
+    {
+        while (true)
+        {
+            auto root = std::atomic_load(&m_root);
+            if (root->m_kind == Kind_::INode)
+                return Cast_<INode_>(root);
+
+            auto descriptor = Cast_<Descriptor_>(root);
+            auto expected = root;
+            if (abort)
+            {
+                if (std::atomic_compare_exchange_strong(&m_root, &expected, Branch_{ descriptor->m_old }))
+                    return descriptor->m_old;
+                continue;
+            }
+
+            if (GcasRead_(*descriptor->m_old, this) == descriptor->m_expected)
+            {
+                if (std::atomic_compare_exchange_strong(&m_root, &expected, Branch_{ descriptor->m_new }))
+                {
+                    descriptor->m_committed.store(true);
+                    return descriptor->m_new;
+                }
+                continue;
+            }
+            if (std::atomic_compare_exchange_strong(&m_root, &expected, Branch_{ descriptor->m_old }))
+                return descriptor->m_old;
+        }
+    }
+
+    auto RdcssRoot_(const std::shared_ptr<INode_>& old, std::shared_ptr<MainNode_> expected_main,
+                    std::shared_ptr<INode_> next) const -> bool
+    {
+        auto descriptor = std::make_shared<Descriptor_>(old, std::move(expected_main), std::move(next));
+        auto expected = Branch_{ old };
+        if (!std::atomic_compare_exchange_strong(&m_root, &expected, Branch_{ descriptor }))
+            return false;
+        CompleteRoot_(false);
+        return descriptor->m_committed.load();
+    }
+
+    // Main node builders
+
+    /**
+     * Returns the branches of `node`, its INodes copied into `generation` if `node` belongs to another one.
+     */
+    auto BranchesIn_(const CNode_& node, const GenerationPtr_& generation) const -> std::vector<Branch_>
+    {
+        auto array = node.m_array;
+        if (node.m_generation == generation)
+            return array;
+        for (auto& branch : array)
+        {
+            if (branch->m_kind == Kind_::INode)
+                branch = std::make_shared<INode_>(GcasRead_(static_cast<INode_&>(*branch), this), generation);
+        }
+        return array;
+    }
+
+    auto Renewed_(const CNode_& node, const GenerationPtr_& generation) const -> std::shared_ptr<MainNode_>
+    {
+        return std::make_shared<CNode_>(node.m_bitmap, BranchesIn_(node, generation), generation);
+    }
+
+    /**
+     * Returns a main node holding both `first` and `second`, whose hashes agree below `level`.
+     */
+    static auto Dual_(const std::shared_ptr<SNode_>& first, const std::shared_ptr<SNode_>& second, unsigned level,
+                      const GenerationPtr_& generation) -> std::shared_ptr<MainNode_>
+    {
+        if (level >= kHashBits)
+            return std::make_shared<LNode_>(std::vector<std::shared_ptr<SNode_>>{ first, second });
+
+        const auto first_index = (first->m_hash >> level) & kMask;
+        const auto second_index = (second->m_hash >> level) & kMask;
+        if (first_index == second_index)
+        {
+            auto below = std::make_shared<INode_>(Dual_(first, second, level + kBits, generation), generation);
+            return std::make_shared<CNode_>(std::uint64_t{ 1 } << first_index, std::vector<Branch_>{ below },
+                                            generation);
+        }
+        const auto bitmap = (std::uint64_t{ 1 } << first_index) | (std::uint64_t{ 1 } << second_index);
+        auto array = first_index < second_index ? std::vector<Branch_>{ first, second }
+                                                : std::vector<Branch_>{ second, first };
+        return std::make_shared<CNode_>(bitmap, std::move(array), generation);
+    }
+
+    /**
+     * Entombs `node` if, below the root, it is left with a single key and no INode.
+     */
+    static auto Contracted_(std::shared_ptr<CNode_> node, unsigned level) -> std::shared_ptr<MainNode_>
+    {
+        if (level > 0 && node->m_array.size() == 1 && node->m_array.front()->m_kind == Kind_::SNode)
+            return std::make_shared<TNode_>(Cast_<SNode_>(node->m_array.front()));
+        return node;
+    }
+
+    /**
+     * Returns `node` with its entombed children moved up as plain keys, contracted.
+     */
+    auto Compressed_(const CNode_& node, unsigned level, const GenerationPtr_& generation) const
+        -> std::shared_ptr<MainNode_>
+    {
+        auto array = node.m_array;
+        for (auto& branch : array)
+        {
+            if (branch->m_kind != Kind_::INode)
+                continue;
+            auto main = GcasRead_(static_cast<INode_&>(*branch), this);
+            if (main->m_kind == Kind_::TNode)
+                branch = static_cast<const TNode_&>(*main).m_entry;
+        }
+        return Contracted_(std::make_shared<CNode_>(node.m_bitmap, std::move(array), generation), level);
+    }
+
+    /**
+     * Compresses the main node of `node`, found holding a tombstone below it.
+     */
+    auto Clean_(const std::shared_ptr<INode_>& node, unsigned level) const -> void
+    {
+        if (!node)
+            return;
+        auto main = GcasRead_(*node, this);
+        if (main->m_kind == Kind_::CNode)
+            Gcas_(*node, main, Compressed_(static_cast<const CNode_&>(*main), level, node->m_generation));
+    }
+
+    /**
+     * After an erase entombed `node`, moves its last key up into `parent`.
+     */
+    auto CleanParent_(const std::shared_ptr<INode_>& parent, const std::shared_ptr<INode_>& node,
+                      std::uint64_t hash, unsigned level, const GenerationPtr_& start) const -> void
+    {
+        while (true)
+        {
+            auto parent_main = GcasRead_(*parent, this);
+            if (parent_main->m_kind != Kind_::CNode)
+                return;
+            const auto& branches = static_cast<const CNode_&>(*parent_main);
+            const auto [flag, position] = FlagPosition_(hash, level, branches.m_bitmap);
+            if (!(branches.m_bitmap & flag) || branches.m_array[position] != node)
+                return;
+            auto main = GcasRead_(*node, this);
+            if (main->m_kind != Kind_::TNode)
+                return;
+
+            auto array = branches.m_array;
+            array[position] = static_cast<const TNode_&>(*main).m_entry;
+            auto replacement =
+                Contracted_(std::make_shared<CNode_>(branches.m_bitmap, std::move(array), node->m_generation), level);
+            if (Gcas_(*parent, parent_main, replacement) || ReadRoot_()->m_generation != start)
+                return;
+        }
+    }
+
+    // Operations. `start` is the root generation when the operation started. `parent` is nullptr at the root.
+
+    /**
+     * Looks `key` up below `node`, setting `found` if present.
+     * @param tree The Trie, or nullptr when reading a read-only snapshot.
+     */
+    static auto Lookup_(const std::shared_ptr<INode_>& node, const Key& key, std::uint64_t hash, unsigned level,
+                        const std::shared_ptr<INode_>& parent, const GenerationPtr_& start,
+                        const CtriePrefixTree* tree, std::shared_ptr<SNode_>& found) -> Status_
+    {
+        auto main = GcasRead_(*node, tree);
+        auto matches = [&key, hash](const SNode_& entry) { return entry.m_hash == hash && entry.m_key == key; };
+
+        if (main->m_kind == Kind_::TNode)
+        {
+            if (tree)
+            {
+                tree->Clean_(parent, level - kBits);
+                return Status_::Restart;
+            }
+            const auto& entry = static_cast<const TNode_&>(*main).m_entry;
+            if (!matches(*entry))
+                return Status_::NotFound;
+            found = entry;
+            return Status_::Found;
+        }
+        if (main->m_kind == Kind_::LNode)
+        {
+            for (const auto& entry : static_cast<const LNode_&>(*main).m_entries)
+            {
+                if (matches(*entry))
+                {
+                    found = entry;
+                    return Status_::Found;
+                }
+            }
+            return Status_::NotFound;
+        }
+
+        const auto& branches = static_cast<const CNode_&>(*main);
+        const auto [flag, position] = FlagPosition_(hash, level, branches.m_bitmap);
+        if (!(branches.m_bitmap & flag))
+            return Status_::NotFound;
+        const auto& branch = branches.m_array[position];
+        if (branch->m_kind == Kind_::SNode)
+        {
+            if (!matches(static_cast<const SNode_&>(*branch)))
+                return Status_::NotFound;
+            found = Cast_<SNode_>(branch);
+            return Status_::Found;
+        }
+
+        auto child = Cast_<INode_>(branch);
+        if (!tree || child->m_generation == start)
+            return Lookup_(child, key, hash, level + kBits, node, start, tree, found);
+        if (tree->Gcas_(*node, main, tree->Renewed_(branches, start)))
+            return Lookup_(node, key, hash, level, parent, start, tree, found);
+        return Status_::Restart;
+    }
+
+    /**
+     * Inserts `entry` below `node`. Returns false if the operation must restart. Sets `added` if the key is new.
+     */
+    auto Insert_(const std::shared_ptr<INode_>& node, const std::shared_ptr<SNode_>& entry, unsigned level,
+                 const std::shared_ptr<INode_>& parent, const GenerationPtr_& start, bool& added) const -> bool
+    {
+        auto main = GcasRead_(*node, this);
+
+        if (main->m_kind == Kind_::TNode)
+        {
+            Clean_(parent, level - kBits);
+            return false;
+        }
+        if (main->m_kind == Kind_::LNode)
+        {
+            auto entries = static_cast<const LNode_&>(*main).m_entries;
+            added = true;
+            for (auto& existing : entries)
+            {
+                if (existing->m_key == entry->m_key)
+                {
+                    existing = entry;
+                    added = false;
+                }
+            }
+            if (added)
+                entries.push_back(entry);
+            return Gcas_(*node, main, std::make_shared<LNode_>(std::move(entries)));
+        }
+
+        const auto& branches = static_cast<const CNode_&>(*main);
+        const auto [flag, position] = FlagPosition_(entry->m_hash, level, branches.m_bitmap);
+        if (!(branches.m_bitmap & flag))
+        {
+            auto array = BranchesIn_(branches, node->m_generation);
+            array.insert(array.begin() + static_cast<std::ptrdiff_t>(position), entry);
+            added = true;
+            return Gcas_(*node, main,
+                         std::make_shared<CNode_>(branches.m_bitmap | flag, std::move(array), node->m_generation));
+        }
+
+        const auto& branch = branches.m_array[position];
+        if (branch->m_kind == Kind_::INode)
+        {
+            auto child = Cast_<INode_>(branch);
+            if (child->m_generation == start)
+                return Insert_(child, entry, level + kBits, node, start, added);
+            if (Gcas_(*node, main, Renewed_(branches, start)))
+                return Insert_(node, entry, level, parent, start, added);
+            return false;
+        }
+
+        auto existing = Cast_<SNode_>(branch);
+        auto array = BranchesIn_(branches, node->m_generation);
+        if (existing->m_hash == entry->m_hash && existing->m_key == entry->m_key)
+        {
+            array[position] = entry;
+            added = false;
+        }
+        else
+        {
+            array[position] =
+                std::make_shared<INode_>(Dual_(existing, entry, level + kBits, node->m_generation), node->m_generation);
+            added = true;
+        }
+        return Gcas_(*node, main, std::make_shared<CNode_>(branches.m_bitmap, std::move(array), node->m_generation));
+    }
+
+    /**
+     * Removes `key` from below `node`, setting `removed` if it was present.
+     */
+    auto Remove_(const std::shared_ptr<INode_>& node, const Key& key, std::uint64_t hash, unsigned level,
+                 const std::shared_ptr<INode_>& parent, const GenerationPtr_& start,
+                 std::shared_ptr<SNode_>& removed) const -> Status_
+    {
+        auto main = GcasRead_(*node, this);
+
+        if (main->m_kind == Kind_::TNode)
+        {
+            Clean_(parent, level - kBits);
+            return Status_::Restart;
+        }
+        if (main->m_kind == Kind_::LNode)
+        {
+            const auto& entries = static_cast<const LNode_&>(*main).m_entries;
+            auto rest = std::vector<std::shared_ptr<SNode_>>{};
+            for (const auto& entry : entries)
+            {
+                if (entry->m_key == key)
+                    removed = entry;
+                else
+                    rest.push_back(entry);
+            }
+            if (!removed)
+                return Status_::NotFound;
+            std::shared_ptr<MainNode_> replacement;
+            if (rest.size() == 1)
+                replacement = std::make_shared<TNode_>(rest.front());
+            else
+                replacement = std::make_shared<LNode_>(std::move(rest));
+            return Gcas_(*node, main, replacement) ? Status_::Found : Status_::Restart;
+        }
+
+        const auto& branches = static_cast<const CNode_&>(*main);
+        const auto [flag, position] = FlagPosition_(hash, level, branches.m_bitmap);
+        if (!(branches.m_bitmap & flag))
+            return Status_::NotFound;
+
+        const auto& branch = branches.m_array[position];
+        if (branch->m_kind == Kind_::INode)
+        {
+            auto child = Cast_<INode_>(branch);
+            if (child->m_generation == start)
+                return Remove_(child, key, hash, level + kBits, node, start, removed);
+            if (Gcas_(*node, main, Renewed_(branches, start)))
+                return Remove_(node, key, hash, level, parent, start, removed);
+            return Status_::Restart;
+        }
+
+        auto existing = Cast_<SNode_>(branch);
+        if (existing->m_hash != hash || existing->m_key != key)
+            return Status_::NotFound;
+        auto array = BranchesIn_(branches, node->m_generation);
+        array.erase(array.begin() + static_cast<std::ptrdiff_t>(position));
+        auto replacement =
+            Contracted_(std::make_shared<CNode_>(branches.m_bitmap ^ flag, std::move(array), node->m_generation), level);
+        if (!Gcas_(*node, main, replacement))
+            return Status_::Restart;
+        removed = existing;
+        if (parent && GcasRead_(*node, this)->m_kind == Kind_::TNode)
+            CleanParent_(parent, node, hash, level - kBits, start);
+        return Status_::Found;
+    }
+
+private:
+    mutable std::shared_ptr<Object_> m_root; // An INode_, or a Descriptor_ while a snapshot is being taken
+    std::atomic<std::size_t> m_size{};
+};
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Epoch-based memory reclamation. \n
+ * \n
+ * Lets readers traverse a structure without any lock while writers unlink and free parts of it. A reader pins
+ * the current global epoch for the duration of its traversal. Writers do not free what they unlink: they
+ * `Retire` it, tagged with the epoch at that time. The global epoch only advances once every pinned reader has
+ * seen it, so once it is two epochs past a retired object, no reader can still hold a pointer to it, and the
+ * object is freed. \n
+ * Refer to: Fraser, "Practical lock-freedom" (2004), section 5.2.3. \n
+ * \n
+ * Readers announce their epoch in one of `kSlots` cache-line-sized slots. A thread keeps reusing the same slot,
+ * so in the common case pinning only touches a cache line no other thread writes to.
+ */
+class EpochManager
+{
+public:
+    static constexpr std::size_t kSlots = 128; // Maximum number of threads pinned at the same time
+
+private:
+    static constexpr std::uint64_t kInactive = std::numeric_limits<std::uint64_t>::max();
+    static constexpr std::size_t kReclaimPeriod = 64; // Retirements between two reclamation attempts
+
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> m_epoch{ kInactive };
+        std::atomic<bool> m_claimed{ false };
+    };
+
+public:
+    /**
+     * Keeps the epoch pinned while alive. Pointers loaded from the protected structure must not be used after
+     * the Guard that was alive when they were loaded is destroyed.
+     */
+    class Guard
+    {
+    public:
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+        Guard(Guard&& other) noexcept : m_slot{ std::exchange(other.m_slot, nullptr) } {}
+        Guard& operator=(Guard&&) = delete;
+
+        ~Guard()
+        {
+            if (!m_slot)
+                return;
+            m_slot->m_epoch.store(kInactive, std::memory_order_release);
+            m_slot->m_claimed.store(false, std::memory_order_release);
+        }
+
+    private:
+        friend class EpochManager;
+        explicit Guard(std::atomic<std::uint64_t>& global, Slot& slot) : m_slot{ &slot }
+        {
+            m_slot->m_epoch.store(global.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+
+        Slot* m_slot;
+    };
+
+    EpochManager() = default;
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    /**
+     * Frees everything still retired. No reader may be pinned anymore.
+     */
+    ~EpochManager()
+    {
+        for (auto& retired : m_retired)
+            retired.m_deleter(retired.m_pointer);
+    }
+
+    /**
+     * Pins the current epoch for the calling thread.
+     */
+    auto Pin() -> Guard
+    {
+        thread_local std::size_t hint = std::hash<std::thread::id>{}(std::this_thread::get_id());
+        for (std::size_t attempt = 0;; ++attempt)
+        {
+            auto& slot = m_slots[(hint + attempt) % kSlots];
+            auto expected = false;
+            if (!slot.m_claimed.load(std::memory_order_relaxed) &&
+                slot.m_claimed.compare_exchange_strong(expected, true, std::memory_order_acquire))
+            {
+                hint = (hint + attempt) % kSlots;
+                return Guard{ m_global, slot };
+            }
+            if (attempt % kSlots == kSlots - 1)
+                std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Hands over an object, already unreachable for new readers, to be freed once no reader can hold it.
+     */
+    template <typename T>
+    auto Retire(T* pointer) -> void
+    {
+        Retire(pointer, [](void* object) { delete static_cast<T*>(object); });
+    }
+
+    /**
+     * Hands over an object, already unreachable for new readers, to be freed by `deleter` once no reader can
+     * hold it.
+     */
+    auto Retire(void* pointer, void (*deleter)(void*)) -> void
+    {
+        std::lock_guard<std::mutex> lock{ m_retired_mutex };
+        m_retired.push_back({ pointer, deleter, m_global.load(std::memory_order_seq_cst) });
+        if (++m_since_reclaim >= kReclaimPeriod)
+            Reclaim_();
+    }
+
+    /**
+     * Advances the epoch if possible, and frees whatever became safe to free.
+     */
+    auto Reclaim() -> void
+    {
+        std::lock_guard<std::mutex> lock{ m_retired_mutex };
+        Reclaim_();
+    }
+
+    /**
+     * Returns the number of retired objects not freed yet.
+     */
+    auto Pending() -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock{ m_retired_mutex };
+        return m_retired.size();
+    }
+
+private:
+    struct Retired
+    {
+        void* m_pointer;
+        void (*m_deleter)(void*);
+        std::uint64_t m_epoch;
+    };
+
+    /**
+     * Tries to advance the global epoch, then frees the objects retired at least two epochs ago.
+     * REQUIRES: m_retired_mutex is held.
+     */
+    auto Reclaim_() -> void
+    {
+        m_since_reclaim = 0;
+        auto global = m_global.load(std::memory_order_seq_cst);
+        const auto all_caught_up = std::all_of(m_slots.begin(), m_slots.end(), [global](const Slot& slot) {
+            const auto epoch = slot.m_epoch.load(std::memory_order_seq_cst);
+            return epoch == kInactive || epoch == global;
+        });
+        if (all_caught_up && m_global.compare_exchange_strong(global, global + 1, std::memory_order_seq_cst))
+            ++global;
+
+        auto kept = std::size_t{ 0 };
+        for (auto& retired : m_retired)
+        {
+            if (retired.m_epoch + 2 <= global)
+                retired.m_deleter(retired.m_pointer);
+            else
+                m_retired[kept++] = retired;
+        }
+        m_retired.resize(kept);
+    }
+
+private:
+    std::atomic<std::uint64_t> m_global{ 0 };
+    std::array<Slot, kSlots> m_slots{};
+    std::mutex m_retired_mutex{};
+    std::vector<Retired> m_retired{};
+    std::size_t m_since_reclaim{}; // Retirements since the last reclamation attempt
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+template <typename EdgeType, typename NodeInfo>
+class MappedPrefixTree;
+
+/**
+ * Frozen, read-optimized Prefix Tree (Trie). \n
+ * \n
+ * Nodes are numbered in breadth-first order, so the children of a node are contiguous, sorted by edge, and
+ * children of consecutive nodes follow each other. The whole structure is then a few flat arrays: the edge
+ * leading to every node, the index of the first child of every node (the children of node i being the nodes
+ * `m_first_child[i]` to `m_first_child[i + 1] - 1`), and for every node the index of its information, if any.
+ * There is no pointer nor per-node allocation, lookups binary search contiguous edges, and the memory used is
+ * a small constant per node on top of the edges and information themselves. \n
+ * A FlatPrefixTree cannot be modified: it is built once, from a PrefixTree or from sorted keys.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree.
+ */
+template <typename EdgeType, typename NodeInfo>
+class FlatPrefixTree
+{
+public:
+    using Key = std::vector<EdgeType>;
+
+    /**
+     * Creates an empty Trie.
+     */
+    FlatPrefixTree() : FlatPrefixTree(std::vector<std::pair<Key, NodeInfo>>{}) {}
+
+    /**
+     * Builds a Trie from keys sorted in increasing order. Repeated keys keep their last information.
+     * @param entries Keys and their information, sorted by key. Consumed.
+     */
+    explicit FlatPrefixTree(std::vector<std::pair<Key, NodeInfo>> entries)
+    {
+        if (entries.size() >= kNone)
+            throw std::length_error("Too many keys for a FlatPrefixTree");
+
+        // Every queued range of entries shares its first `depth` edges, and becomes the next node
+        struct Range
+        {
+            std::size_t m_first;
+            std::size_t m_last;
+            std::size_t m_depth;
+        };
+        auto ranges = std::queue<Range>{};
+        ranges.push({ 0, entries.size(), 0 });
+        m_labels.emplace_back();
+        while (!ranges.empty())
+        {
+            auto [first, last, depth] = ranges.front();
+            ranges.pop();
+
+            auto info_index = kNone;
+            while (first < last && entries[first].first.size() == depth)
+            {
+                if (info_index == kNone)
+                {
+                    info_index = static_cast<std::uint32_t>(m_infos.size());
+                    m_infos.push_back(std::move(entries[first].second));
+                }
+                else
+                {
+                    m_infos.back() = std::move(entries[first].second);
+                }
+                ++first;
+            }
+            m_info_index.push_back(info_index);
+
+            m_first_child.push_back(Index_(m_labels.size()));
+            while (first < last)
+            {
+                const auto& label = entries[first].first[depth];
+                auto end = first + 1;
+                while (end < last && !(label < entries[end].first[depth]))
+                    ++end;
+                m_labels.push_back(label);
+                ranges.push({ first, end, depth + 1 });
+                first = end;
+            }
+        }
+        m_first_child.push_back(Index_(m_labels.size()));
+    }
+
+    /**
+     * Builds a Trie with the keys and information of `tree`.
+     */
+    template <typename Reducer>
+    static auto From(const PrefixTree<EdgeType, NodeInfo, Reducer>& tree) -> FlatPrefixTree
+    {
+        auto entries = std::vector<std::pair<Key, NodeInfo>>{};
+        entries.reserve(tree.Size());
+        tree.ForEach([&entries](const Key& key, const NodeInfo& info) { entries.emplace_back(key, info); });
+        return FlatPrefixTree{ std::move(entries) };
+    }
+
+    /**
+     * Returns the information associated with `key`, or tl::nullopt.
+     */
+    auto Get(const Key& key) const -> tl::optional<const NodeInfo&>
+    {
+        auto node = Find_(key);
+        if (node == kNone || m_info_index[node] == kNone)
+            return tl::nullopt;
+        return m_infos[m_info_index[node]];
+    }
+
+    /**
+     * Returns true if `key` is present.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Calls `callback(const Key&, const NodeInfo&)` on every key, in increasing key order.
+     */
+    template <typename Callback>
+    auto ForEach(Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEach_(0, key, callback);
+    }
+
+    /**
+     * Returns the number of keys.
+     */
+    auto Size() const -> std::size_t { return m_infos.size(); }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return m_infos.empty(); }
+
+    /**
+     * Returns the number of nodes, the root included.
+     */
+    auto NodeCount() const -> std::size_t { return m_info_index.size(); }
+
+private:
+    friend class MappedPrefixTree<EdgeType, NodeInfo>;
+
+    static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+    static auto Index_(std::size_t index) -> std::uint32_t
+    {
+        if (index >= kNone)
+            throw std::length_error("Too many nodes for a FlatPrefixTree");
+        return static_cast<std::uint32_t>(index);
+    }
+
+    /**
+     * Returns the node of `key`, or kNone.
+     */
+    auto Find_(const Key& key) const -> std::uint32_t
+    {
+        std::uint32_t node = 0;
+        for (const auto& edge_value : key)
+        {
+            const auto first = m_labels.begin() + m_first_child[node];
+            const auto last = m_labels.begin() + m_first_child[node + 1];
+            auto it = std::lower_bound(first, last, edge_value);
+            if (it == last || edge_value < *it)
+                return kNone;
+            node = static_cast<std::uint32_t>(it - m_labels.begin());
+        }
+        return node;
+    }
+
+    template <typename Callback>
+    auto ForEach_(std::uint32_t node, Key& key, Callback& callback) const -> void
+    {
+        if (m_info_index[node] != kNone)
+            callback(key, m_infos[m_info_index[node]]);
+        for (auto child = m_first_child[node]; child < m_first_child[node + 1]; ++child)
+        {
+            key.push_back(m_labels[child]);
+            ForEach_(child, key, callback);
+            key.pop_back();
+        }
+    }
+
+private:
+    std::vector<EdgeType> m_labels{};             // Edge leading to every node. The root has a placeholder.
+    std::vector<std::uint32_t> m_first_child{};   // First child of every node, plus one past the last node
+    std::vector<std::uint32_t> m_info_index{};    // Index of the information of every node in m_infos, or kNone
+    std::vector<NodeInfo> m_infos{};              // In node order
+};
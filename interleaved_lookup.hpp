@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+/**
+ * Interleaved lookups written as coroutines. \n
+ * \n
+ * With C++20 coroutines, a lookup can be written as straight-line code that suspends after every edge it
+ * follows: `PrefixTree::Lookup::Step` prefetches the node reached, and `co_await std::suspend_always{}` lets
+ * the scheduler resume other lookups while that node is loaded. `RunInterleaved` keeps a group of such
+ * coroutines in flight and resumes them in turns. \n
+ * Without coroutine support, the C++17 fallback only provides `InterleavedGet`, on top of
+ * `PrefixTree::MultiGet`, which interleaves hand-written lookup state machines the same way. \n
+ * Refer to: Jonathan, Minhas, Hofmann, Gottschlich, Weikum, "Exploiting Coroutines to Attack the
+ * 'Killer Nanoseconds'", VLDB 2018.
+ */
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+/**
+ * Coroutine producing a `T`, started and resumed by hand. \n
+ * \n
+ * It suspends before running, so that creating it is cheap, and after returning, so that its result can be
+ * read. A lookup written as an InterleavedTask looks like:
+ * \code
+ * auto Find(const Tree& tree, const Key& key) -> InterleavedTask<bool>
+ * {
+ *     auto lookup = tree.MakeLookup(key);
+ *     while (!lookup.Step())
+ *         co_await std::suspend_always{};
+ *     co_return lookup.Result().has_value();
+ * }
+ * \endcode
+ * @tparam T Result of the coroutine.
+ */
+template <typename T>
+class InterleavedTask
+{
+public:
+    struct promise_type
+    {
+        promise_type() = default; // Not an aggregate, so it is never built from the coroutine arguments
+
+        auto get_return_object() -> InterleavedTask
+        {
+            return InterleavedTask{ std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+        auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+        auto final_suspend() noexcept -> std::suspend_always { return {}; }
+        auto return_value(T value) -> void { m_value.emplace(std::move(value)); }
+        auto unhandled_exception() -> void { m_error = std::current_exception(); }
+
+        tl::optional<T> m_value{};
+        std::exception_ptr m_error{};
+    };
+
+    InterleavedTask(InterleavedTask&& other) noexcept : m_handle{ std::exchange(other.m_handle, nullptr) } {}
+    InterleavedTask& operator=(InterleavedTask&& other) noexcept
+    {
+        std::swap(m_handle, other.m_handle);
+        return *this;
+    }
+    InterleavedTask(const InterleavedTask&) = delete;
+    InterleavedTask& operator=(const InterleavedTask&) = delete;
+
+    ~InterleavedTask()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    /**
+     * Runs the coroutine until it suspends or returns. REQUIRES: !Done().
+     */
+    auto Resume() -> void { m_handle.resume(); }
+
+    /**
+     * Returns true once the coroutine returned or threw.
+     */
+    auto Done() const -> bool { return m_handle.done(); }
+
+    /**
+     * Returns the result of the coroutine, or rethrows its exception. REQUIRES: Done().
+     */
+    auto Result() -> T&
+    {
+        if (m_handle.promise().m_error)
+            std::rethrow_exception(m_handle.promise().m_error);
+        return m_handle.promise().m_value.value();
+    }
+
+private:
+    explicit InterleavedTask(std::coroutine_handle<promise_type> handle) : m_handle{ handle } {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * Runs `count` coroutines, keeping `group` of them in flight and resuming them in turns.
+ * @param count Number of coroutines.
+ * @param group Number of coroutines in flight.
+ * @param make_task Called as `make_task(std::size_t index)`, returning the InterleavedTask of coroutine `index`.
+ * @param on_result Called as `on_result(std::size_t index, T& result)` once coroutine `index` returned.
+ */
+template <typename MakeTask, typename OnResult>
+auto RunInterleaved(std::size_t count, std::size_t group, MakeTask&& make_task, OnResult&& on_result) -> void
+{
+    using Task = decltype(make_task(std::size_t{}));
+    auto in_flight = std::vector<std::pair<std::size_t, Task>>{};
+    std::size_t next = 0;
+    for (; next < count && in_flight.size() < std::max<std::size_t>(group, 1); ++next)
+        in_flight.emplace_back(next, make_task(next));
+
+    while (!in_flight.empty())
+    {
+        for (std::size_t i = 0; i < in_flight.size();)
+        {
+            auto& [index, task] = in_flight[i];
+            task.Resume();
+            if (!task.Done())
+            {
+                ++i;
+                continue;
+            }
+            on_result(index, task.Result());
+            if (next < count)
+            {
+                in_flight[i] = { next, make_task(next) };
+                ++next;
+                ++i;
+            }
+            else
+            {
+                in_flight[i] = std::move(in_flight.back());
+                in_flight.pop_back();
+            }
+        }
+    }
+}
+
+/**
+ * Coroutine looking up `key` in `tree`, suspending after every edge it follows.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer>
+auto InterleavedDescent(const PrefixTree<EdgeType, NodeInfo, Reducer>& tree, const std::vector<EdgeType>& key)
+    -> InterleavedTask<tl::optional<const NodeInfo&>>
+{
+    auto lookup = tree.MakeLookup(key);
+    while (!lookup.Step())
+        co_await std::suspend_always{};
+    co_return lookup.Result();
+}
+
+/**
+ * Looks up many keys with one coroutine per key, keeping `group` of them in flight. \n
+ * Same results as `PrefixTree::MultiGet`.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer>
+auto InterleavedGet(const PrefixTree<EdgeType, NodeInfo, Reducer>& tree, const std::vector<std::vector<EdgeType>>& keys,
+                    std::size_t group = 8) -> std::vector<tl::optional<const NodeInfo&>>
+{
+    using Result = tl::optional<const NodeInfo&>;
+    auto results = std::vector<Result>(keys.size());
+    RunInterleaved(
+        keys.size(), group, [&](std::size_t index) { return InterleavedDescent(tree, keys[index]); },
+        [&results](std::size_t index, Result& result) { results[index] = result; });
+    return results;
+}
+
+#else
+
+/**
+ * Looks up many keys, keeping `group` lookups in flight. Without coroutine support, this is
+ * `PrefixTree::MultiGet`.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer>
+auto InterleavedGet(const PrefixTree<EdgeType, NodeInfo, Reducer>& tree, const std::vector<std::vector<EdgeType>>& keys,
+                    std::size_t group = 8) -> std::vector<tl::optional<const NodeInfo&>>
+{
+    return tree.MultiGet(keys, group);
+}
+
+#endif
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mapped_prefix_tree.hpp"
+#include "prefix_tree.hpp"
+
+/**
+ * Read-only Prefix Tree (Trie) loading its subtrees from a mapped file on first access. \n
+ * \n
+ * `Write` cuts a Trie at depth `split_depth`. The keys shorter than that form the top of the Trie, and the keys
+ * below every node at that depth form a subtree, written on its own with `PrefixTree::Serialize`. A directory
+ * Trie maps the prefix of every subtree to the place of its bytes in the file. \n
+ * Opening a file maps it, and only loads the top and the directory. The subtrees are stubs until a lookup
+ * reaches them: the subtree is then deserialized into a PrefixTree, and its pages of the file are released, so
+ * that memory follows the subtrees in use rather than the whole file. \n
+ * Loaded subtrees are kept in least recently used order. Once their serialized bytes exceed the residency
+ * budget, the coldest ones are evicted, back to stubs, and loaded again if needed. The subtree being read is
+ * never evicted, so a single subtree larger than the budget still loads. \n
+ * Lookups return copies, as the subtree they come from may be evicted right after. A mutex guards the cache,
+ * so the Trie may be read from several threads.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree.
+ * @tparam InfoCodec Codec of NodeInfo. Refer to `TrivialCodec`.
+ * @tparam EdgeCodec Codec of EdgeType. Refer to `TrivialCodec`.
+ */
+template <typename EdgeType, typename NodeInfo, typename InfoCodec = TrivialCodec<NodeInfo>,
+          typename EdgeCodec = TrivialCodec<EdgeType>>
+class LazyPrefixTree
+{
+public:
+    using Key = std::vector<EdgeType>;
+    using Tree = PrefixTree<EdgeType, NodeInfo>;
+
+    /**
+     * Writes the keys of `tree` to `out`, cut at depth `split_depth`. Refer to the class comment.
+     * @param out Stream to write to, opened in binary mode. Throws std::runtime_error if writing fails.
+     * @param tree Trie to write.
+     * @param split_depth Depth of the subtrees loaded on demand. Deeper means more, smaller subtrees.
+     */
+    template <typename Reducer>
+    static auto Write(std::ostream& out, const PrefixTree<EdgeType, NodeInfo, Reducer>& tree, std::size_t split_depth,
+                      const InfoCodec& info_codec = InfoCodec{}, const EdgeCodec& edge_codec = EdgeCodec{}) -> void
+    {
+        auto trailer = Trailer{};
+        std::copy(std::begin(kMagic), std::end(kMagic), std::begin(trailer.m_magic));
+        trailer.m_version = kFormatVersion;
+        trailer.m_split_depth = split_depth;
+        trailer.m_keys = tree.Size();
+
+        std::uint64_t offset = sizeof(kMagic);
+        out.write(kMagic, sizeof(kMagic));
+        auto write_blob = [&](const auto& blob_tree, auto codec) -> Slot {
+            auto blob = std::ostringstream{};
+            blob_tree.Serialize(blob, codec, edge_codec);
+            const auto bytes = blob.str();
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            const auto slot = Slot{ offset, bytes.size() };
+            offset += bytes.size();
+            return slot;
+        };
+
+        // Keys come in order, so those of a subtree follow each other
+        auto top = Tree{};
+        auto directory = PrefixTree<EdgeType, Slot>{};
+        auto subtree = Tree{};
+        auto prefix = Key{};
+        auto flush_subtree = [&]() {
+            if (!subtree.Empty())
+                directory.Insert(prefix, write_blob(subtree, info_codec));
+            subtree = Tree{};
+        };
+        tree.ForEach([&](const Key& key, const NodeInfo& info) {
+            if (key.size() < split_depth)
+            {
+                top.Insert(key, info);
+                return;
+            }
+            if (subtree.Empty() || !std::equal(prefix.begin(), prefix.end(), key.begin()))
+            {
+                flush_subtree();
+                prefix.assign(key.begin(), key.begin() + static_cast<std::ptrdiff_t>(split_depth));
+            }
+            subtree.Insert(Key(key.begin() + static_cast<std::ptrdiff_t>(split_depth), key.end()), info);
+        });
+        flush_subtree();
+
+        const auto top_slot = write_blob(top, info_codec);
+        trailer.m_top_offset = top_slot.m_offset;
+        trailer.m_top_size = top_slot.m_size;
+        const auto directory_slot = write_blob(directory, TrivialCodec<Slot>{});
+        trailer.m_directory_offset = directory_slot.m_offset;
+        trailer.m_directory_size = directory_slot.m_size;
+        out.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+        if (!out)
+            throw std::runtime_error("Failed to write LazyPrefixTree");
+    }
+
+    /**
+     * Maps the file at `path`, written by `Write`, and loads its top and directory. Throws std::system_error if
+     * it cannot be mapped, and std::runtime_error if it is not valid.
+     * @param path File to map.
+     * @param residency_budget Serialized bytes of the subtrees kept loaded. Refer to the class comment.
+     */
+    LazyPrefixTree(const std::string& path, std::size_t residency_budget, InfoCodec info_codec = InfoCodec{},
+                   EdgeCodec edge_codec = EdgeCodec{})
+        : m_file{ path }, m_residency_budget{ residency_budget }, m_info_codec{ std::move(info_codec) },
+          m_edge_codec{ std::move(edge_codec) }
+    {
+        auto trailer = Trailer{};
+        if (m_file.Size() < sizeof(kMagic) + sizeof(trailer))
+            throw std::runtime_error("Not a LazyPrefixTree: " + path);
+        std::memcpy(&trailer, m_file.Data() + m_file.Size() - sizeof(trailer), sizeof(trailer));
+        const auto end = m_file.Size() - sizeof(trailer);
+        if (!std::equal(std::begin(kMagic), std::end(kMagic), m_file.Data()) ||
+            !std::equal(std::begin(kMagic), std::end(kMagic), std::begin(trailer.m_magic)) ||
+            trailer.m_version != kFormatVersion || !InFile_({ trailer.m_top_offset, trailer.m_top_size }, end) ||
+            !InFile_({ trailer.m_directory_offset, trailer.m_directory_size }, end))
+            throw std::runtime_error("Not a LazyPrefixTree: " + path);
+
+        m_split_depth = trailer.m_split_depth;
+        m_size = trailer.m_keys;
+        m_top = Load_<Tree>({ trailer.m_top_offset, trailer.m_top_size }, m_info_codec);
+        m_directory = Load_<PrefixTree<EdgeType, Slot>>({ trailer.m_directory_offset, trailer.m_directory_size },
+                                                         TrivialCodec<Slot>{});
+    }
+
+    LazyPrefixTree(const LazyPrefixTree&) = delete;
+    LazyPrefixTree& operator=(const LazyPrefixTree&) = delete;
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. Loads its subtree if needed.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        auto copy = [](tl::optional<const NodeInfo&> info) -> tl::optional<NodeInfo> {
+            if (!info)
+                return tl::nullopt;
+            return info.value();
+        };
+        if (key.size() < m_split_depth)
+            return copy(m_top.Get(key));
+
+        const auto split = key.begin() + static_cast<std::ptrdiff_t>(m_split_depth);
+        auto slot = m_directory.Get(Key(key.begin(), split));
+        if (!slot)
+            return tl::nullopt;
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        return copy(Resident_(slot.value()).Get(Key(split, key.end())));
+    }
+
+    /**
+     * Returns true if `key` is present. Loads its subtree if needed.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Returns the number of keys, loaded or not.
+     */
+    auto Size() const -> std::size_t { return m_size; }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return m_size == 0; }
+
+    /**
+     * Returns the number of subtrees, loaded or not.
+     */
+    auto SubtreeCount() const -> std::size_t { return m_directory.Size(); }
+
+    /**
+     * Returns the number of subtrees currently loaded.
+     */
+    auto ResidentCount() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        return m_resident.size();
+    }
+
+    /**
+     * Returns the serialized bytes of the subtrees currently loaded. Refer to the residency budget.
+     */
+    auto ResidentBytes() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        return m_resident_bytes;
+    }
+
+private:
+    static constexpr char kMagic[8] = { 'P', 'T', 'R', 'E', 'L', 'A', 'Z', 'Y' };
+    static constexpr std::uint64_t kFormatVersion = 1;
+
+    // Place of a serialized Trie in the file
+    struct Slot
+    {
+        std::uint64_t m_offset;
+        std::uint64_t m_size;
+    };
+
+    // End of the file, written once every subtree is
+    struct Trailer
+    {
+        std::uint64_t m_version;
+        std::uint64_t m_split_depth;
+        std::uint64_t m_keys;
+        std::uint64_t m_top_offset;
+        std::uint64_t m_top_size;
+        std::uint64_t m_directory_offset;
+        std::uint64_t m_directory_size;
+        char m_magic[8];
+    };
+
+    struct Resident
+    {
+        std::uint64_t m_offset;
+        std::size_t m_size;
+        Tree m_tree;
+    };
+
+    // Read-only stream over bytes of the mapping, so that they are deserialized without being copied first
+    class MappedBuffer_ : public std::streambuf
+    {
+    public:
+        MappedBuffer_(const char* data, std::size_t size)
+        {
+            auto* begin = const_cast<char*>(data); // Never written to: this buffer has no put area
+            setg(begin, begin, begin + size);
+        }
+    };
+
+    static auto InFile_(const Slot& slot, std::size_t end) -> bool
+    {
+        return slot.m_offset >= sizeof(kMagic) && slot.m_offset <= end && slot.m_size <= end - slot.m_offset;
+    }
+
+    template <typename Loaded, typename Codec>
+    auto Load_(const Slot& slot, const Codec& codec) const -> Loaded
+    {
+        if (!InFile_(slot, m_file.Size()))
+            throw std::runtime_error("Corrupted LazyPrefixTree");
+        auto buffer = MappedBuffer_{ m_file.Data() + slot.m_offset, slot.m_size };
+        auto in = std::istream{ &buffer };
+        auto loaded = Loaded::Deserialize(in, codec, m_edge_codec);
+        m_file.Release(slot.m_offset, slot.m_size);
+        return loaded;
+    }
+
+    /**
+     * Returns the subtree of `slot`, loading it if needed, and marks it most recently used. Evicts the least
+     * recently used subtrees beyond the budget. REQUIRES: m_mutex is held.
+     */
+    auto Resident_(const Slot& slot) const -> const Tree&
+    {
+        auto found = m_by_offset.find(slot.m_offset);
+        if (found != m_by_offset.end())
+        {
+            m_resident.splice(m_resident.begin(), m_resident, found->second);
+            return found->second->m_tree;
+        }
+
+        m_resident.push_front({ slot.m_offset, slot.m_size, Load_<Tree>(slot, m_info_codec) });
+        m_by_offset.emplace(slot.m_offset, m_resident.begin());
+        m_resident_bytes += slot.m_size;
+        while (m_resident_bytes > m_residency_budget && m_resident.size() > 1)
+        {
+            m_resident_bytes -= m_resident.back().m_size;
+            m_by_offset.erase(m_resident.back().m_offset);
+            m_resident.pop_back();
+        }
+        return m_resident.front().m_tree;
+    }
+
+private:
+    MappedFile m_file;
+    std::size_t m_residency_budget;
+    InfoCodec m_info_codec;
+    EdgeCodec m_edge_codec;
+    std::size_t m_split_depth{};
+    std::size_t m_size{};
+    Tree m_top{};                                  // Keys shorter than m_split_depth
+    PrefixTree<EdgeType, Slot> m_directory{};      // Subtree of every prefix of length m_split_depth
+
+    mutable std::mutex m_mutex{}; // Guards the resident subtrees
+    mutable std::list<Resident> m_resident{}; // Most recently used first
+    mutable std::unordered_map<std::uint64_t, typename std::list<Resident>::iterator> m_by_offset{};
+    mutable std::size_t m_resident_bytes{};
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+/**
+ * Leapfrog Triejoin: worst-case optimal multi-way join over PrefixTrees. \n
+ * \n
+ * Each relation is a PrefixTree whose keys are tuples, one position per attribute. Every attribute is bound
+ * to a join variable, and variables are bound one at a time in increasing order: for each variable, the
+ * cursors of the relations using it are intersected by leapfrogging (repeatedly seeking the smallest cursor
+ * to the largest key), and only values present in all of them are expanded further. No intermediate result
+ * is materialized, and cyclic queries such as triangles run in worst-case optimal time. \n
+ * Refer to: Veldhuizen, "Leapfrog Triejoin: A Simple, Worst-Case Optimal Join Algorithm" (2014). \n
+ * \n
+ * The Tries must outlive the join, and must not be modified while it runs.
+ * @tparam EdgeType Edge type of the Tries, i.e. the type of every attribute.
+ * @tparam NodeInfo Information stored with each tuple (e.g. a row).
+ * @tparam Reducer Reducer of the Tries. Refer to PrefixTree.
+ */
+template <typename EdgeType, typename NodeInfo, typename Reducer = NoReducer>
+class LeapfrogTriejoin
+{
+public:
+    using Tree = PrefixTree<EdgeType, NodeInfo, Reducer>;
+
+    /**
+     * Adds a relation to the join. \n
+     * \n
+     * Keys of `tree` must all have `variables.size()` edges, and `variables` must be strictly increasing: the
+     * attribute order of every relation has to agree with the global variable order.
+     * @param tree Trie holding the tuples of the relation.
+     * @param variables Join variable bound by each position of the keys.
+     */
+    auto AddRelation(const Tree& tree, std::vector<std::size_t> variables) -> void
+    {
+        if (!std::is_sorted(variables.begin(), variables.end()) ||
+            std::adjacent_find(variables.begin(), variables.end()) != variables.end())
+            throw std::invalid_argument("Relation variables must be strictly increasing");
+
+        for (auto variable : variables)
+        {
+            if (variable >= m_participants.size())
+                m_participants.resize(variable + 1);
+            m_participants[variable].push_back(m_relations.size());
+        }
+        m_relations.push_back({ &tree, std::move(variables) });
+    }
+
+    /**
+     * Runs the join, visiting every result in increasing lexicographic order of the variables.
+     * @param callback Called as `callback(const std::vector<EdgeType>& binding, const std::vector<const NodeInfo*>&
+     * rows)`, with one value per variable and the information of the matching tuple of each relation, in the
+     * order the relations were added.
+     */
+    template <typename Callback>
+    auto Run(Callback&& callback) const -> void
+    {
+        for (const auto& participants : m_participants)
+        {
+            if (participants.empty())
+                throw std::invalid_argument("Every join variable must be used by a relation");
+        }
+
+        auto cursors = std::vector<typename Tree::Cursor>{};
+        cursors.reserve(m_relations.size());
+        for (const auto& relation : m_relations)
+            cursors.push_back(relation.m_tree->MakeCursor());
+
+        auto binding = std::vector<EdgeType>{};
+        binding.reserve(m_participants.size());
+        auto rows = std::vector<const NodeInfo*>(m_relations.size());
+        if (!m_participants.empty())
+            Join_(cursors, binding, rows, callback);
+    }
+
+private:
+    struct Relation
+    {
+        const Tree* m_tree;
+        std::vector<std::size_t> m_variables;
+    };
+
+    static auto Equal_(const EdgeType& lhs, const EdgeType& rhs) -> bool { return !(lhs < rhs) && !(rhs < lhs); }
+
+    /**
+     * Binds the variable `binding.size()`, and recurses on the next one for every value all its relations share.
+     */
+    template <typename Callback>
+    auto Join_(std::vector<typename Tree::Cursor>& cursors, std::vector<EdgeType>& binding,
+               std::vector<const NodeInfo*>& rows, Callback& callback) const -> void
+    {
+        if (binding.size() == m_participants.size())
+        {
+            // Keys erased from a Trie may leave a path without information behind
+            for (std::size_t relation = 0; relation < cursors.size(); ++relation)
+            {
+                auto info = cursors[relation].Info();
+                if (!info)
+                    return;
+                rows[relation] = &info.value();
+            }
+            callback(binding, rows);
+            return;
+        }
+
+        // Leapfrog search over the cursors of the relations using this variable, ordered by their current key
+        auto participants = std::vector<typename Tree::Cursor*>{};
+        for (auto relation : m_participants[binding.size()])
+            participants.push_back(&cursors[relation]);
+        for (auto cursor : participants)
+            cursor->Open();
+
+        const auto any_at_end = std::any_of(participants.begin(), participants.end(),
+                                            [](const auto* cursor) { return cursor->AtEnd(); });
+        if (!any_at_end)
+        {
+            std::sort(participants.begin(), participants.end(),
+                      [](const auto* lhs, const auto* rhs) { return lhs->Key() < rhs->Key(); });
+
+            std::size_t current = 0;
+            auto max_key = participants.back()->Key();
+            while (true)
+            {
+                auto& cursor = *participants[current];
+                if (Equal_(cursor.Key(), max_key))
+                {
+                    // Every cursor agrees on this value
+                    binding.push_back(max_key);
+                    Join_(cursors, binding, rows, callback);
+                    binding.pop_back();
+                    cursor.Next();
+                }
+                else
+                {
+                    cursor.Seek(max_key);
+                }
+
+                if (cursor.AtEnd())
+                    break;
+                max_key = cursor.Key();
+                current = (current + 1) % participants.size();
+            }
+        }
+
+        for (auto cursor : participants)
+            cursor->Up();
+    }
+
+private:
+    std::vector<Relation> m_relations{};
+    std::vector<std::vector<std::size_t>> m_participants{}; // Relations using each variable
+};
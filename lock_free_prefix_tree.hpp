@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+#include "tl_optional.hpp"
+
+/**
+ * Concurrent Prefix Tree (Trie) whose readers never lock. \n
+ * \n
+ * Every node publishes its edges as an immutable, sorted array, and its information as an immutable object,
+ * both behind atomic pointers. Writers are serialized by a mutex, never modify what they have published, and
+ * publish replacements with release stores, so a reader following the pointers with acquire loads always sees
+ * fully built nodes. Whatever a writer replaces or unlinks is retired to an EpochManager, and only freed once no
+ * reader can still be traversing it. \n
+ * Unlike PrefixTree, `Erase` prunes: nodes left without information and without edges are unlinked, so churn
+ * does not leave empty branches behind. \n
+ * Lookups take no lock and write no shared cache line, so readers scale with the number of cores.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree. Lookups return copies of it.
+ */
+template <typename EdgeType, typename NodeInfo>
+class LockFreePrefixTree
+{
+private:
+    struct Node;
+
+    // Published edges of a node. Never modified once published: writers replace the whole array.
+    struct Edges
+    {
+        std::vector<std::pair<EdgeType, Node*>> m_entries{}; // Sorted by edge
+    };
+
+    struct Node
+    {
+        std::atomic<const Edges*> m_edges{ nullptr };   // nullptr if the node has no edges
+        std::atomic<const NodeInfo*> m_info{ nullptr }; // nullptr if the node is not terminal
+    };
+
+    using Key = std::vector<EdgeType>;
+
+public:
+    LockFreePrefixTree() = default;
+    LockFreePrefixTree(const LockFreePrefixTree&) = delete;
+    LockFreePrefixTree& operator=(const LockFreePrefixTree&) = delete;
+
+    /**
+     * Frees every node. No other thread may use the Trie anymore.
+     */
+    ~LockFreePrefixTree() { Free_(m_root); }
+
+    /**
+     * Inserts or overwrites a key. Refer to `PrefixTree::Insert`. \n
+     * \n
+     * Writers are serialized, and never block readers.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        std::lock_guard<std::mutex> lock{ m_writer_mutex };
+        auto current = &m_root;
+        for (const auto& edge_value : key)
+        {
+            auto next = Find_(*current, edge_value, std::memory_order_relaxed);
+            if (!next)
+            {
+                next = new Node{};
+                Link_(*current, edge_value, next);
+            }
+            current = next;
+        }
+
+        auto previous = current->m_info.exchange(new NodeInfo(std::move(info)), std::memory_order_acq_rel);
+        if (previous)
+            m_epochs.Retire(const_cast<NodeInfo*>(previous));
+        else
+            m_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. \n
+     * \n
+     * Takes no lock: the traversal is protected by pinning the current epoch.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        auto guard = m_epochs.Pin();
+        auto info = FindInfo_(key);
+        if (!info)
+            return tl::nullopt;
+        return *info;
+    }
+
+    /**
+     * Calls `callback(const NodeInfo&)` on the information of `key` without copying it, if the key is present.
+     * The reference must not escape the callback. Returns true if the key was present.
+     */
+    template <typename Callback>
+    auto Visit(const Key& key, Callback&& callback) const -> bool
+    {
+        auto guard = m_epochs.Pin();
+        auto info = FindInfo_(key);
+        if (!info)
+            return false;
+        callback(*info);
+        return true;
+    }
+
+    /**
+     * Returns true if `key` is present. Takes no lock.
+     */
+    auto Contains(const Key& key) const -> bool
+    {
+        auto guard = m_epochs.Pin();
+        return FindInfo_(key) != nullptr;
+    }
+
+    /**
+     * Erases a key, and unlinks every node left without information and edges on its path. \n
+     * \n
+     * Throws if the key is not present. Unlinked nodes are freed once no reader can reach them anymore.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        std::lock_guard<std::mutex> lock{ m_writer_mutex };
+        auto path = std::vector<Node*>{ &m_root };
+        for (const auto& edge_value : key)
+        {
+            auto next = Find_(*path.back(), edge_value, std::memory_order_relaxed);
+            if (!next)
+                throw std::runtime_error("Erasing key not present in Trie");
+            path.push_back(next);
+        }
+
+        auto previous = path.back()->m_info.exchange(nullptr, std::memory_order_acq_rel);
+        if (!previous)
+            throw std::runtime_error("Erasing key not present in Trie");
+        m_epochs.Retire(const_cast<NodeInfo*>(previous));
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+
+        // Prune bottom-up while nodes are left empty
+        for (auto depth = key.size(); depth > 0; --depth)
+        {
+            auto node = path[depth];
+            if (node->m_info.load(std::memory_order_relaxed) || node->m_edges.load(std::memory_order_relaxed))
+                break;
+            Unlink_(*path[depth - 1], key[depth - 1]);
+            m_epochs.Retire(node);
+        }
+    }
+
+    /**
+     * Returns the number of keys.
+     */
+    auto Size() const -> std::size_t { return m_size.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+private:
+    /**
+     * Returns the child of `node` through `edge_value`, or nullptr.
+     */
+    static auto Find_(const Node& node, const EdgeType& edge_value, std::memory_order order) -> Node*
+    {
+        auto edges = node.m_edges.load(order);
+        if (!edges)
+            return nullptr;
+        const auto& entries = edges->m_entries;
+        auto it = std::lower_bound(entries.begin(), entries.end(), edge_value,
+                                   [](const auto& entry, const EdgeType& value) { return entry.first < value; });
+        if (it == entries.end() || edge_value < it->first)
+            return nullptr;
+        return it->second;
+    }
+
+    /**
+     * Returns the information of `key`, or nullptr. REQUIRES: the epoch is pinned.
+     */
+    auto FindInfo_(const Key& key) const -> const NodeInfo*
+    {
+        const Node* current = &m_root;
+        for (const auto& edge_value : key)
+        {
+            current = Find_(*current, edge_value, std::memory_order_acquire);
+            if (!current)
+                return nullptr;
+        }
+        return current->m_info.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Publishes a copy of the edges of `node` with `child` added. REQUIRES: m_writer_mutex is held.
+     */
+    auto Link_(Node& node, const EdgeType& edge_value, Node* child) -> void
+    {
+        auto previous = node.m_edges.load(std::memory_order_relaxed);
+        auto edges = previous ? new Edges{ *previous } : new Edges{};
+        auto& entries = edges->m_entries;
+        auto it = std::lower_bound(entries.begin(), entries.end(), edge_value,
+                                   [](const auto& entry, const EdgeType& value) { return entry.first < value; });
+        entries.emplace(it, edge_value, child);
+
+        node.m_edges.store(edges, std::memory_order_release);
+        if (previous)
+            m_epochs.Retire(const_cast<Edges*>(previous));
+    }
+
+    /**
+     * Publishes a copy of the edges of `node` without `edge_value`. REQUIRES: m_writer_mutex is held.
+     */
+    auto Unlink_(Node& node, const EdgeType& edge_value) -> void
+    {
+        auto previous = node.m_edges.load(std::memory_order_relaxed);
+        Edges* edges = nullptr;
+        if (previous->m_entries.size() > 1)
+        {
+            edges = new Edges{};
+            edges->m_entries.reserve(previous->m_entries.size() - 1);
+            for (const auto& entry : previous->m_entries)
+            {
+                if (entry.first < edge_value || edge_value < entry.first)
+                    edges->m_entries.push_back(entry);
+            }
+        }
+
+        node.m_edges.store(edges, std::memory_order_release);
+        m_epochs.Retire(const_cast<Edges*>(previous));
+    }
+
+    /**
+     * Frees the subtree of `node`, excluding `node` itself. REQUIRES: no concurrent access.
+     */
+    static auto Free_(Node& node) -> void
+    {
+        delete node.m_info.load(std::memory_order_relaxed);
+        auto edges = node.m_edges.load(std::memory_order_relaxed);
+        if (!edges)
+            return;
+        for (const auto& entry : edges->m_entries)
+        {
+            Free_(*entry.second);
+            delete entry.second;
+        }
+        delete edges;
+    }
+
+private:
+    mutable EpochManager m_epochs{}; // Declared first, so it frees retired objects last
+    Node m_root{};
+    std::mutex m_writer_mutex{};
+    std::atomic<std::size_t> m_size{};
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flat_prefix_tree.hpp"
+
+/**
+ * Read-only mapping of a whole file, unmapped on destruction. Requires POSIX `mmap`.
+ */
+class MappedFile
+{
+public:
+    /**
+     * Maps the file at `path`. Throws std::system_error if it cannot be opened or mapped.
+     */
+    explicit MappedFile(const std::string& path)
+    {
+        const int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file < 0)
+            throw std::system_error(errno, std::generic_category(), "Cannot open " + path);
+        struct stat status = {};
+        if (::fstat(file, &status) != 0)
+        {
+            const int error = errno;
+            ::close(file);
+            throw std::system_error(error, std::generic_category(), "Cannot stat " + path);
+        }
+        m_size = static_cast<std::size_t>(status.st_size);
+        void* mapping = m_size == 0 ? nullptr : ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, file, 0);
+        const int error = errno;
+        ::close(file); // The mapping keeps the file alive
+        if (mapping == MAP_FAILED)
+            throw std::system_error(error, std::generic_category(), "Cannot map " + path);
+        m_data = static_cast<const char*>(mapping);
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data{ std::exchange(other.m_data, nullptr) }, m_size{ std::exchange(other.m_size, 0) }
+    {
+    }
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (m_data)
+            ::munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    auto Data() const -> const char* { return m_data; }
+    auto Size() const -> std::size_t { return m_size; }
+
+    /**
+     * Drops the pages fully inside bytes [offset, offset + size) from the memory of this process. They stay in
+     * the page cache, and are mapped again if read.
+     */
+    auto Release(std::size_t offset, std::size_t size) const -> void
+    {
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const auto first = (offset + page - 1) / page * page;
+        const auto last = std::min(offset + size, m_size) / page * page;
+        if (first < last)
+            ::madvise(const_cast<char*>(m_data) + first, last - first, MADV_DONTNEED);
+    }
+
+private:
+    const char* m_data{};
+    std::size_t m_size{}; // In bytes
+};
+
+/**
+ * Read-only Prefix Tree (Trie) queried in place from a memory-mapped file. \n
+ * \n
+ * The file holds the arrays of a FlatPrefixTree as they are in memory: the edge leading to every node, the
+ * first child of every node, the index of the information of every node, and the information themselves.
+ * Nodes refer to each other by index, never by pointer, so the file is valid wherever it is mapped. \n
+ * Opening a file only maps it and checks its header, whatever its size, and pages are loaded on demand by
+ * the queries that touch them. Several processes mapping the same file share its pages in the page cache. \n
+ * The file is trusted: only its header and size are checked, not the arrays themselves. It must be written by
+ * `Write` on a machine with the same representation of EdgeType and NodeInfo (size, alignment, endianness).
+ * Requires POSIX `mmap`.
+ * @tparam EdgeType Refer to PrefixTree. Must be trivially copyable.
+ * @tparam NodeInfo Refer to PrefixTree. Must be trivially copyable.
+ */
+template <typename EdgeType, typename NodeInfo>
+class MappedPrefixTree
+{
+    static_assert(std::is_trivially_copyable_v<EdgeType>, "MappedPrefixTree needs a trivially copyable EdgeType");
+    static_assert(std::is_trivially_copyable_v<NodeInfo>, "MappedPrefixTree needs a trivially copyable NodeInfo");
+
+public:
+    using Key = std::vector<EdgeType>;
+    using Flat = FlatPrefixTree<EdgeType, NodeInfo>;
+
+    /**
+     * Writes `tree` to `out` in the layout mapped by the constructor.
+     * @param out Stream to write to, opened in binary mode. Throws std::runtime_error if writing fails.
+     */
+    static auto Write(std::ostream& out, const Flat& tree) -> void
+    {
+        auto header = Header{};
+        std::copy(std::begin(kMagic), std::end(kMagic), std::begin(header.m_magic));
+        header.m_version = kFormatVersion;
+        header.m_edge_size = sizeof(EdgeType);
+        header.m_info_size = sizeof(NodeInfo);
+        header.m_nodes = tree.m_info_index.size();
+        header.m_keys = tree.m_infos.size();
+        const auto layout = Layout_(header.m_nodes, header.m_keys);
+
+        std::size_t written = 0;
+        auto write = [&out, &written](std::size_t offset, const void* data, std::size_t size) {
+            static const char padding[kMaxAlignment]{};
+            out.write(padding, static_cast<std::streamsize>(offset - written));
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            written = offset + size;
+        };
+        write(0, &header, sizeof(header));
+        write(layout.m_labels, tree.m_labels.data(), tree.m_labels.size() * sizeof(EdgeType));
+        write(layout.m_first_child, tree.m_first_child.data(), tree.m_first_child.size() * sizeof(std::uint32_t));
+        write(layout.m_info_index, tree.m_info_index.data(), tree.m_info_index.size() * sizeof(std::uint32_t));
+        write(layout.m_infos, tree.m_infos.data(), tree.m_infos.size() * sizeof(NodeInfo));
+        if (!out)
+            throw std::runtime_error("Failed to write MappedPrefixTree");
+    }
+
+    /**
+     * Writes the keys of `tree` to `out`. Refer to the other overload.
+     */
+    template <typename Reducer>
+    static auto Write(std::ostream& out, const PrefixTree<EdgeType, NodeInfo, Reducer>& tree) -> void
+    {
+        Write(out, Flat::From(tree));
+    }
+
+    /**
+     * Maps the file at `path`, written by `Write`. Throws std::system_error if it cannot be mapped, and
+     * std::runtime_error if it does not hold a Trie of this type.
+     */
+    explicit MappedPrefixTree(const std::string& path) : m_file{ path }
+    {
+        auto header = Header{};
+        if (m_file.Size() < sizeof(header))
+            throw std::runtime_error("Not a MappedPrefixTree: " + path);
+        std::memcpy(&header, m_file.Data(), sizeof(header));
+        if (!std::equal(std::begin(kMagic), std::end(kMagic), std::begin(header.m_magic)) ||
+            header.m_version != kFormatVersion || header.m_edge_size != sizeof(EdgeType) ||
+            header.m_info_size != sizeof(NodeInfo) || header.m_nodes == 0 || header.m_nodes >= Flat::kNone ||
+            header.m_keys > header.m_nodes || Layout_(header.m_nodes, header.m_keys).m_end > m_file.Size())
+            throw std::runtime_error("Not a MappedPrefixTree of this type: " + path);
+
+        const auto layout = Layout_(header.m_nodes, header.m_keys);
+        m_labels = reinterpret_cast<const EdgeType*>(m_file.Data() + layout.m_labels);
+        m_first_child = reinterpret_cast<const std::uint32_t*>(m_file.Data() + layout.m_first_child);
+        m_info_index = reinterpret_cast<const std::uint32_t*>(m_file.Data() + layout.m_info_index);
+        m_infos = reinterpret_cast<const NodeInfo*>(m_file.Data() + layout.m_infos);
+        m_keys = header.m_keys;
+    }
+
+    // Moving the mapping does not move its pages, so the array pointers stay valid
+    MappedPrefixTree(MappedPrefixTree&&) noexcept = default;
+    MappedPrefixTree& operator=(MappedPrefixTree&&) noexcept = default;
+    MappedPrefixTree(const MappedPrefixTree&) = delete;
+    MappedPrefixTree& operator=(const MappedPrefixTree&) = delete;
+
+    /**
+     * Returns the information associated with `key`, or tl::nullopt. The reference points into the mapping.
+     */
+    auto Get(const Key& key) const -> tl::optional<const NodeInfo&>
+    {
+        auto node = Find_(key);
+        if (node == Flat::kNone || m_info_index[node] == Flat::kNone)
+            return tl::nullopt;
+        return m_infos[m_info_index[node]];
+    }
+
+    /**
+     * Returns true if `key` is present.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Calls `callback(const Key&, const NodeInfo&)` on every key starting with `prefix`, in increasing key order.
+     */
+    template <typename Callback>
+    auto ForEachWithPrefix(const Key& prefix, Callback&& callback) const -> void
+    {
+        auto node = Find_(prefix);
+        if (node == Flat::kNone)
+            return;
+        auto key = prefix;
+        ForEach_(node, key, callback);
+    }
+
+    /**
+     * Returns the length of the longest prefix of `key` that is present, `key` itself included, or tl::nullopt
+     * if none is.
+     */
+    auto LongestPrefixMatch(const Key& key) const -> tl::optional<std::size_t>
+    {
+        auto result = tl::optional<std::size_t>{};
+        std::uint32_t node = 0;
+        for (std::size_t depth = 0;; ++depth)
+        {
+            if (m_info_index[node] != Flat::kNone)
+                result = depth;
+            if (depth == key.size())
+                break;
+            node = Child_(node, key[depth]);
+            if (node == Flat::kNone)
+                break;
+        }
+        return result;
+    }
+
+    /**
+     * Returns the number of keys.
+     */
+    auto Size() const -> std::size_t { return m_keys; }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return m_keys == 0; }
+
+private:
+    static constexpr char kMagic[8] = { 'P', 'T', 'R', 'E', 'M', 'A', 'P', '\0' };
+    static constexpr std::uint32_t kFormatVersion = 1;
+    static constexpr std::size_t kMaxAlignment = std::max({ alignof(std::uint64_t), alignof(EdgeType), alignof(NodeInfo) });
+
+    // Start of the file. Every array follows at the next offset aligned for its type.
+    struct Header
+    {
+        char m_magic[8];
+        std::uint32_t m_version;
+        std::uint32_t m_edge_size;
+        std::uint32_t m_info_size;
+        std::uint32_t m_padding;
+        std::uint64_t m_nodes;
+        std::uint64_t m_keys;
+    };
+
+    // Offsets of the arrays, in bytes from the start of the file
+    struct Layout
+    {
+        std::size_t m_labels;
+        std::size_t m_first_child;
+        std::size_t m_info_index;
+        std::size_t m_infos;
+        std::size_t m_end;
+    };
+
+    static auto Layout_(std::uint64_t nodes, std::uint64_t keys) -> Layout
+    {
+        auto align = [](std::size_t offset, std::size_t alignment) {
+            return (offset + alignment - 1) / alignment * alignment;
+        };
+        const std::size_t node_count = nodes;
+        const std::size_t key_count = keys;
+        auto layout = Layout{};
+        layout.m_labels = align(sizeof(Header), alignof(EdgeType));
+        layout.m_first_child = align(layout.m_labels + node_count * sizeof(EdgeType), alignof(std::uint32_t));
+        layout.m_info_index = layout.m_first_child + (node_count + 1) * sizeof(std::uint32_t);
+        layout.m_infos = align(layout.m_info_index + node_count * sizeof(std::uint32_t), alignof(NodeInfo));
+        layout.m_end = layout.m_infos + key_count * sizeof(NodeInfo);
+        return layout;
+    }
+
+    /**
+     * Returns the child of `node` through `edge_value`, or kNone.
+     */
+    auto Child_(std::uint32_t node, const EdgeType& edge_value) const -> std::uint32_t
+    {
+        const auto* first = m_labels + m_first_child[node];
+        const auto* last = m_labels + m_first_child[node + 1];
+        const auto* it = std::lower_bound(first, last, edge_value);
+        if (it == last || edge_value < *it)
+            return Flat::kNone;
+        return static_cast<std::uint32_t>(it - m_labels);
+    }
+
+    /**
+     * Returns the node of `key`, or kNone.
+     */
+    auto Find_(const Key& key) const -> std::uint32_t
+    {
+        std::uint32_t node = 0;
+        for (const auto& edge_value : key)
+        {
+            node = Child_(node, edge_value);
+            if (node == Flat::kNone)
+                break;
+        }
+        return node;
+    }
+
+    template <typename Callback>
+    auto ForEach_(std::uint32_t node, Key& key, Callback& callback) const -> void
+    {
+        if (m_info_index[node] != Flat::kNone)
+            callback(key, m_infos[m_info_index[node]]);
+        for (auto child = m_first_child[node]; child < m_first_child[node + 1]; ++child)
+        {
+            key.push_back(m_labels[child]);
+            ForEach_(child, key, callback);
+            key.pop_back();
+        }
+    }
+
+private:
+    MappedFile m_file;
+    const EdgeType* m_labels{};
+    const std::uint32_t* m_first_child{};
+    const std::uint32_t* m_info_index{};
+    const NodeInfo* m_infos{};
+    std::size_t m_keys{};
+};
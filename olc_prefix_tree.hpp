@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+#include "tl_optional.hpp"
+
+/**
+ * Concurrent Prefix Tree (Trie) synchronized with optimistic lock coupling. \n
+ * \n
+ * Every node carries a version lock. Readers never write to a node: they read its version, read the edge they
+ * need, and validate that the version did not change before moving to the child, restarting from the root if
+ * it did. Writers traverse the same way and only lock the node they modify, upgrading from the version they
+ * read, so inserts into disjoint subtrees never contend on any lock. \n
+ * Edges are modified in place under the node lock. A node whose edge array is full gets a bigger copy, and
+ * the old array, as well as replaced information and unlinked nodes, are retired to an EpochManager, since
+ * optimistic readers may still be reading them. \n
+ * Refer to: Leis et al., "The ART of Practical Synchronization" (2016). \n
+ * \n
+ * `Erase` clears the information of the key, and unlinks its node if that leaves it without edges, locking
+ * that node and its parent.
+ * @tparam EdgeType Refer to PrefixTree. Must be trivially copyable, as edges are read while being written.
+ * @tparam NodeInfo Refer to PrefixTree. Lookups return copies of it.
+ */
+template <typename EdgeType, typename NodeInfo>
+class OlcPrefixTree
+{
+    static_assert(std::is_trivially_copyable_v<EdgeType>, "OlcPrefixTree requires a trivially copyable EdgeType");
+
+private:
+    /**
+     * Version lock of a node. \n
+     * \n
+     * Bit 1 is set while a writer holds the lock, and bit 0 once the node is unlinked (obsolete). Every unlock
+     * increases the version, so a reader that sees the same unlocked version before and after reading knows
+     * nothing changed in between.
+     */
+    class VersionLock
+    {
+    public:
+        static constexpr std::uint64_t kObsolete = 0b01;
+        static constexpr std::uint64_t kLocked = 0b10;
+
+        /**
+         * Returns the current version, or tl::nullopt if the node is locked or obsolete (the caller restarts).
+         */
+        auto ReadVersion() const -> tl::optional<std::uint64_t>
+        {
+            const auto version = m_word.load(std::memory_order_acquire);
+            if (version & (kLocked | kObsolete))
+            {
+                if (version & kLocked)
+                    std::this_thread::yield();
+                return tl::nullopt;
+            }
+            return version;
+        }
+
+        /**
+         * Returns true if the node did not change since `version` was read. Orders the reads before it.
+         */
+        auto Validate(std::uint64_t version) const -> bool
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return m_word.load(std::memory_order_relaxed) == version;
+        }
+
+        /**
+         * Takes the lock if the node is still at `version`. Returns false otherwise (the caller restarts).
+         */
+        auto TryUpgrade(std::uint64_t version) -> bool
+        {
+            return m_word.compare_exchange_strong(version, version + kLocked, std::memory_order_acquire);
+        }
+
+        auto Unlock() -> void { m_word.fetch_add(kLocked, std::memory_order_release); }
+        auto UnlockObsolete() -> void { m_word.fetch_add(kLocked | kObsolete, std::memory_order_release); }
+
+    private:
+        std::atomic<std::uint64_t> m_word{ 0b100 };
+    };
+
+    struct Node;
+
+    // Sorted edges of a node, modified in place under the node lock
+    struct Edges
+    {
+        explicit Edges(std::size_t capacity)
+            : m_capacity{ capacity }, m_labels{ std::make_unique<std::atomic<EdgeType>[]>(capacity) },
+              m_children{ std::make_unique<std::atomic<Node*>[]>(capacity) }
+        {
+        }
+
+        std::size_t m_capacity;
+        std::atomic<std::size_t> m_count{ 0 };
+        std::unique_ptr<std::atomic<EdgeType>[]> m_labels;
+        std::unique_ptr<std::atomic<Node*>[]> m_children;
+    };
+
+    struct Node
+    {
+        VersionLock m_lock{};
+        std::atomic<Edges*> m_edges{ nullptr };
+        std::atomic<const NodeInfo*> m_info{ nullptr };
+    };
+
+    using Key = std::vector<EdgeType>;
+
+public:
+    OlcPrefixTree() = default;
+    OlcPrefixTree(const OlcPrefixTree&) = delete;
+    OlcPrefixTree& operator=(const OlcPrefixTree&) = delete;
+
+    /**
+     * Frees every node. No other thread may use the Trie anymore.
+     */
+    ~OlcPrefixTree() { Free_(m_root); }
+
+    /**
+     * Inserts or overwrites a key. Refer to `PrefixTree::Insert`. \n
+     * \n
+     * Locks a single node: the one gaining a new edge, or the one whose information changes.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        auto guard = m_epochs.Pin();
+        auto new_info = std::make_unique<NodeInfo>(std::move(info));
+        while (!TryInsert_(key, new_info))
+        {
+        }
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt. Never locks.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        auto guard = m_epochs.Pin();
+        while (true)
+        {
+            auto result = tl::optional<NodeInfo>{};
+            auto found = Find_(key, [&result](const Node& node) {
+                auto info = node.m_info.load(std::memory_order_acquire);
+                if (info)
+                    result = *info;
+            });
+            if (found)
+                return result;
+        }
+    }
+
+    /**
+     * Returns true if `key` is present. Never locks.
+     */
+    auto Contains(const Key& key) const -> bool
+    {
+        auto guard = m_epochs.Pin();
+        while (true)
+        {
+            auto present = false;
+            auto found = Find_(key, [&present](const Node& node) {
+                present = node.m_info.load(std::memory_order_acquire) != nullptr;
+            });
+            if (found)
+                return present;
+        }
+    }
+
+    /**
+     * Erases a key. Throws if it is not present. \n
+     * \n
+     * Locks the node of the key, and its parent if the node is left without edges and gets unlinked.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        auto guard = m_epochs.Pin();
+        while (true)
+        {
+            auto outcome = TryErase_(key);
+            if (outcome == EraseOutcome_::Missing)
+                throw std::runtime_error("Erasing key not present in Trie");
+            if (outcome == EraseOutcome_::Erased)
+                return;
+        }
+    }
+
+    /**
+     * Returns the number of keys.
+     */
+    auto Size() const -> std::size_t { return m_size.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+private:
+    enum class EraseOutcome_
+    {
+        Erased,
+        Missing,
+        Restart
+    };
+
+    /**
+     * Returns the child of `node` through `edge_value`, or nullptr. The result is only meaningful if the node
+     * version is validated afterwards. REQUIRES: the epoch is pinned.
+     */
+    static auto FindChild_(const Node& node, const EdgeType& edge_value) -> Node*
+    {
+        auto edges = node.m_edges.load(std::memory_order_acquire);
+        if (!edges)
+            return nullptr;
+        std::size_t low = 0;
+        std::size_t high = std::min(edges->m_count.load(std::memory_order_relaxed), edges->m_capacity);
+        while (low < high)
+        {
+            const auto middle = low + (high - low) / 2;
+            if (edges->m_labels[middle].load(std::memory_order_relaxed) < edge_value)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low == edges->m_capacity)
+            return nullptr;
+        const auto label = edges->m_labels[low].load(std::memory_order_relaxed);
+        if (low >= edges->m_count.load(std::memory_order_relaxed) || edge_value < label || label < edge_value)
+            return nullptr;
+        return edges->m_children[low].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Optimistically walks down to the node of `key`, and calls `on_node(node)` on it. \n
+     * Returns false if a concurrent change was detected and the caller must restart. Missing keys return true
+     * without calling `on_node`. REQUIRES: the epoch is pinned.
+     */
+    template <typename OnNode>
+    auto Find_(const Key& key, OnNode&& on_node) const -> bool
+    {
+        const Node* node = &m_root;
+        auto version = node->m_lock.ReadVersion();
+        if (!version)
+            return false;
+
+        for (const auto& edge_value : key)
+        {
+            const Node* child = FindChild_(*node, edge_value);
+            if (!node->m_lock.Validate(version.value()))
+                return false;
+            if (!child)
+                return true;
+
+            auto child_version = child->m_lock.ReadVersion();
+            if (!child_version || !node->m_lock.Validate(version.value()))
+                return false;
+            node = child;
+            version = child_version;
+        }
+
+        on_node(*node);
+        return node->m_lock.Validate(version.value());
+    }
+
+    /**
+     * One optimistic attempt at `Insert`. Returns false if it must be restarted. `info` is consumed on success.
+     */
+    auto TryInsert_(const Key& key, std::unique_ptr<NodeInfo>& info) -> bool
+    {
+        Node* node = &m_root;
+        auto version = node->m_lock.ReadVersion();
+        if (!version)
+            return false;
+
+        for (std::size_t depth = 0; depth < key.size(); ++depth)
+        {
+            Node* child = FindChild_(*node, key[depth]);
+            if (!node->m_lock.Validate(version.value()))
+                return false;
+
+            if (!child)
+            {
+                // The rest of the path is built unpublished, then linked under the only lock taken
+                if (!node->m_lock.TryUpgrade(version.value()))
+                    return false;
+                AddEdge_(*node, key[depth], BuildChain_(key, depth + 1, info));
+                node->m_lock.Unlock();
+                m_size.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            auto child_version = child->m_lock.ReadVersion();
+            if (!child_version || !node->m_lock.Validate(version.value()))
+                return false;
+            node = child;
+            version = child_version;
+        }
+
+        if (!node->m_lock.TryUpgrade(version.value()))
+            return false;
+        auto previous = node->m_info.exchange(info.release(), std::memory_order_acq_rel);
+        node->m_lock.Unlock();
+        if (previous)
+            m_epochs.Retire(const_cast<NodeInfo*>(previous));
+        else
+            m_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * Builds, unpublished, the nodes for `key[from...]`, the last one taking `info`. Returns the first one.
+     */
+    auto BuildChain_(const Key& key, std::size_t from, std::unique_ptr<NodeInfo>& info) -> Node*
+    {
+        auto first = new Node{};
+        auto last = first;
+        for (auto depth = from; depth < key.size(); ++depth)
+        {
+            auto next = new Node{};
+            AddEdge_(*last, key[depth], next);
+            last = next;
+        }
+        last->m_info.store(info.release(), std::memory_order_relaxed);
+        return first;
+    }
+
+    /**
+     * Adds an edge to `node`, growing its edge array if needed. REQUIRES: `node` is locked or unpublished.
+     */
+    auto AddEdge_(Node& node, const EdgeType& edge_value, Node* child) -> void
+    {
+        auto edges = node.m_edges.load(std::memory_order_relaxed);
+        const auto count = edges ? edges->m_count.load(std::memory_order_relaxed) : 0;
+        if (!edges || count == edges->m_capacity)
+        {
+            auto grown = new Edges{ edges ? edges->m_capacity * 2 : kInitialCapacity };
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                grown->m_labels[i].store(edges->m_labels[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                grown->m_children[i].store(edges->m_children[i].load(std::memory_order_relaxed),
+                                           std::memory_order_relaxed);
+            }
+            grown->m_count.store(count, std::memory_order_relaxed);
+            node.m_edges.store(grown, std::memory_order_release);
+            if (edges)
+                m_epochs.Retire(edges);
+            edges = grown;
+        }
+
+        // Shift the larger edges right, then write the new one in its slot
+        auto position = count;
+        while (position > 0 && edge_value < edges->m_labels[position - 1].load(std::memory_order_relaxed))
+        {
+            edges->m_labels[position].store(edges->m_labels[position - 1].load(std::memory_order_relaxed),
+                                            std::memory_order_relaxed);
+            edges->m_children[position].store(edges->m_children[position - 1].load(std::memory_order_relaxed),
+                                              std::memory_order_relaxed);
+            --position;
+        }
+        edges->m_labels[position].store(edge_value, std::memory_order_relaxed);
+        edges->m_children[position].store(child, std::memory_order_release);
+        edges->m_count.store(count + 1, std::memory_order_release);
+    }
+
+    /**
+     * Removes the edge `edge_value` from `node`. REQUIRES: `node` is locked and has that edge.
+     */
+    static auto RemoveEdge_(Node& node, const EdgeType& edge_value) -> void
+    {
+        auto edges = node.m_edges.load(std::memory_order_relaxed);
+        const auto count = edges->m_count.load(std::memory_order_relaxed);
+        std::size_t position = 0;
+        while (edges->m_labels[position].load(std::memory_order_relaxed) < edge_value)
+            ++position;
+        for (; position + 1 < count; ++position)
+        {
+            edges->m_labels[position].store(edges->m_labels[position + 1].load(std::memory_order_relaxed),
+                                            std::memory_order_relaxed);
+            edges->m_children[position].store(edges->m_children[position + 1].load(std::memory_order_relaxed),
+                                              std::memory_order_relaxed);
+        }
+        edges->m_count.store(count - 1, std::memory_order_release);
+    }
+
+    /**
+     * One optimistic attempt at `Erase`.
+     */
+    auto TryErase_(const Key& key) -> EraseOutcome_
+    {
+        Node* parent = nullptr;
+        auto parent_version = tl::optional<std::uint64_t>{};
+        Node* node = &m_root;
+        auto version = node->m_lock.ReadVersion();
+        if (!version)
+            return EraseOutcome_::Restart;
+
+        for (const auto& edge_value : key)
+        {
+            Node* child = FindChild_(*node, edge_value);
+            if (!node->m_lock.Validate(version.value()))
+                return EraseOutcome_::Restart;
+            if (!child)
+                return EraseOutcome_::Missing;
+
+            auto child_version = child->m_lock.ReadVersion();
+            if (!child_version || !node->m_lock.Validate(version.value()))
+                return EraseOutcome_::Restart;
+            parent = node;
+            parent_version = version;
+            node = child;
+            version = child_version;
+        }
+
+        if (!node->m_lock.TryUpgrade(version.value()))
+            return EraseOutcome_::Restart;
+        auto previous = node->m_info.exchange(nullptr, std::memory_order_acq_rel);
+        if (!previous)
+        {
+            node->m_lock.Unlock();
+            return EraseOutcome_::Missing;
+        }
+        m_epochs.Retire(const_cast<NodeInfo*>(previous));
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+
+        // Unlink the node if it is now a leaf. Never waits on the parent lock, so it cannot deadlock:
+        // if the parent changed meanwhile, the empty node is simply left in place.
+        auto edges = node->m_edges.load(std::memory_order_relaxed);
+        const auto is_leaf = !edges || edges->m_count.load(std::memory_order_relaxed) == 0;
+        if (parent && is_leaf && parent->m_lock.TryUpgrade(parent_version.value()))
+        {
+            RemoveEdge_(*parent, key.back());
+            parent->m_lock.Unlock();
+            node->m_lock.UnlockObsolete();
+            if (edges)
+                m_epochs.Retire(edges);
+            m_epochs.Retire(node);
+            return EraseOutcome_::Erased;
+        }
+        node->m_lock.Unlock();
+        return EraseOutcome_::Erased;
+    }
+
+    /**
+     * Frees the subtree of `node`, excluding `node` itself. REQUIRES: no concurrent access.
+     */
+    static auto Free_(Node& node) -> void
+    {
+        delete node.m_info.load(std::memory_order_relaxed);
+        auto edges = node.m_edges.load(std::memory_order_relaxed);
+        if (!edges)
+            return;
+        for (std::size_t i = 0; i < edges->m_count.load(std::memory_order_relaxed); ++i)
+        {
+            auto child = edges->m_children[i].load(std::memory_order_relaxed);
+            Free_(*child);
+            delete child;
+        }
+        delete edges;
+    }
+
+private:
+    static constexpr std::size_t kInitialCapacity = 4;
+
+    mutable EpochManager m_epochs{}; // Declared first, so it frees retired objects last
+    Node m_root{};
+    std::atomic<std::size_t> m_size{};
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "tl_optional.hpp"
+
+/**
+ * Persistent (immutable) Prefix Tree (Trie). \n
+ * \n
+ * A PersistentPrefixTree is never modified: `Insert` and `Erase` return a new version, and leave this one
+ * valid and unchanged. Only the nodes on the path of the key are copied, and every other subtree is shared
+ * between both versions, so an update costs O(depth) node copies, and copying a version is O(1). \n
+ * Nodes are immutable once shared, so versions can be read from several threads at the same time without
+ * synchronization, which makes them suitable for MVCC snapshots or undo histories. \n
+ * Unlike PrefixTree, `Erase` prunes the nodes it leaves without information and without edges.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree. Must be copyable, as versions share nothing mutable.
+ */
+template <typename EdgeType, typename NodeInfo>
+class PersistentPrefixTree
+{
+private:
+    struct Node
+    {
+        std::map<EdgeType, std::shared_ptr<const Node>> m_next{}; // Shared between versions
+        tl::optional<NodeInfo> m_info{};
+    };
+
+public:
+    using Key = std::vector<EdgeType>;
+
+    /**
+     * Creates an empty version.
+     */
+    PersistentPrefixTree() : m_root{ std::make_shared<const Node>() } {}
+
+    /**
+     * Returns a new version with `key` inserted or overwritten. Refer to `PrefixTree::Insert`.
+     */
+    auto Insert(const Key& key, NodeInfo info) const -> PersistentPrefixTree
+    {
+        const auto path = Path_(key);
+        auto node = path.size() > key.size() ? std::make_shared<Node>(*path.back()) : std::make_shared<Node>();
+        const auto added = !node->m_info.has_value();
+        node->m_info = std::move(info);
+        return PersistentPrefixTree{ CopyPath_(key, path, std::move(node)), added ? m_size + 1 : m_size };
+    }
+
+    /**
+     * Returns a new version with `key` erased. Throws if it is not present.
+     */
+    auto Erase(const Key& key) const -> PersistentPrefixTree
+    {
+        const auto path = Path_(key);
+        if (path.size() <= key.size() || !path.back()->m_info)
+            throw std::runtime_error("Erasing key not present in Trie");
+
+        auto node = std::make_shared<Node>(*path.back());
+        node->m_info = tl::nullopt;
+        return PersistentPrefixTree{ CopyPath_(key, path, std::move(node)), m_size - 1 };
+    }
+
+    /**
+     * Returns the information associated with `key`, or tl::nullopt. \n
+     * The reference stays valid as long as a version holding the key is alive.
+     */
+    auto Get(const Key& key) const -> tl::optional<const NodeInfo&>
+    {
+        const auto path = Path_(key);
+        if (path.size() <= key.size() || !path.back()->m_info)
+            return tl::nullopt;
+        return path.back()->m_info.value();
+    }
+
+    /**
+     * Returns true if `key` is present in this version.
+     */
+    auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+    /**
+     * Calls `callback(const Key&, const NodeInfo&)` on every key of this version, in key order.
+     */
+    template <typename Callback>
+    auto ForEach(Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEach_(*m_root, key, callback);
+    }
+
+    /**
+     * Returns the number of keys in this version.
+     */
+    auto Size() const -> std::size_t { return m_size; }
+
+    /**
+     * Returns true if this version holds no keys.
+     */
+    auto Empty() const -> bool { return m_size == 0; }
+
+private:
+    PersistentPrefixTree(std::shared_ptr<const Node> root, std::size_t size) : m_root{ std::move(root) }, m_size{ size }
+    {
+    }
+
+    /**
+     * Returns the nodes along `key`, starting with the root. Shorter than `key.size() + 1` if the key is not
+     * a path of this version.
+     */
+    auto Path_(const Key& key) const -> std::vector<const Node*>
+    {
+        auto path = std::vector<const Node*>{ m_root.get() };
+        path.reserve(key.size() + 1);
+        for (const auto& edge_value : key)
+        {
+            const auto& edges = path.back()->m_next;
+            auto it = edges.find(edge_value);
+            if (it == edges.end())
+                break;
+            path.push_back(it->second.get());
+        }
+        return path;
+    }
+
+    /**
+     * Copies the nodes of `path` above `node`, the new node of `key`, and returns the new root. Copies left
+     * without information and edges are pruned, except the root.
+     */
+    static auto CopyPath_(const Key& key, const std::vector<const Node*>& path, std::shared_ptr<Node> node)
+        -> std::shared_ptr<const Node>
+    {
+        for (auto depth = key.size(); depth > 0; --depth)
+        {
+            auto parent = depth - 1 < path.size() ? std::make_shared<Node>(*path[depth - 1]) : std::make_shared<Node>();
+            if (node->m_info || !node->m_next.empty())
+                parent->m_next[key[depth - 1]] = std::move(node);
+            else
+                parent->m_next.erase(key[depth - 1]);
+            node = std::move(parent);
+        }
+        return node;
+    }
+
+    template <typename Callback>
+    static auto ForEach_(const Node& node, Key& key, Callback& callback) -> void
+    {
+        if (node.m_info)
+            callback(key, node.m_info.value());
+        for (const auto& [edge, child] : node.m_next)
+        {
+            key.push_back(edge);
+            ForEach_(*child, key, callback);
+            key.pop_back();
+        }
+    }
+
+private:
+    std::shared_ptr<const Node> m_root;
+    std::size_t m_size{};
+};
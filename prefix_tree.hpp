@@ -1,13 +1,147 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <istream>
 #include <map>
 #include <memory>
+#include <ostream>
+#include <queue>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "thread_pool.hpp"
 #include "tl_optional.hpp"
 
+/**
+ * Single position of a pattern, as used by `PrefixTree::Match`. \n
+ * \n
+ * A position either matches one concrete edge value, any edge value (wildcard),
+ * or any edge value inside an inclusive range. \n
+ * Concrete values convert implicitly, so a pattern can be written as `{ tenant, Any(), 2024, Any() }`.
+ * @tparam EdgeType Same edge type as the Trie being queried.
+ */
+template <typename EdgeType>
+class PatternElement
+{
+public:
+    enum class Kind
+    {
+        Exact,
+        Any,
+        Range
+    };
+
+    PatternElement(EdgeType value) : m_kind{ Kind::Exact }, m_low{ value }, m_high{ std::move(value) } {}
+
+    /**
+     * Wildcard position, matching every edge value.
+     */
+    static auto Any() -> PatternElement { return PatternElement{}; }
+
+    /**
+     * Position matching every edge value in the inclusive range [low, high].
+     */
+    static auto Range(EdgeType low, EdgeType high) -> PatternElement
+    {
+        auto element = PatternElement{};
+        element.m_kind = Kind::Range;
+        element.m_low = std::move(low);
+        element.m_high = std::move(high);
+        return element;
+    }
+
+    auto GetKind() const -> Kind { return m_kind; }
+    auto Low() const -> const EdgeType& { return m_low.value(); }
+    auto High() const -> const EdgeType& { return m_high.value(); }
+
+private:
+    PatternElement() = default;
+
+    Kind m_kind{ Kind::Any };
+    tl::optional<EdgeType> m_low{};
+    tl::optional<EdgeType> m_high{};
+};
+
+template <typename EdgeType, typename NodeInfo>
+class AhoCorasick;
+
+/**
+ * Codec used by `PrefixTree::Serialize` and `PrefixTree::Deserialize` by default, writing values as their raw
+ * bytes. \n
+ * \n
+ * A codec provides `Write(std::ostream&, const T&)` and `Read(std::istream&) -> T`. The raw bytes of a value
+ * only make sense on machines with the same representation of T (size, endianness), so types that hold
+ * pointers, or streams shared between different machines, need a codec of their own.
+ * @tparam T Trivially copyable, default constructible type.
+ */
+template <typename T>
+struct TrivialCodec
+{
+    static_assert(std::is_trivially_copyable_v<T>, "TrivialCodec needs a trivially copyable type");
+
+    auto Write(std::ostream& out, const T& value) const -> void
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    auto Read(std::istream& in) const -> T
+    {
+        T value{};
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+};
+
+/**
+ * Default `Reducer` of a PrefixTree: nothing is aggregated, and nodes carry no annotation.
+ */
+struct NoReducer
+{
+};
+
+/**
+ * Reducer keeping the maximum score found in each subtree, which enables `PrefixTree::TopK`. \n
+ * \n
+ * A Reducer folds the information of every key in a subtree into a single `Value`: \n
+ * - `Lift(const NodeInfo&) -> Value` turns the information of a single key into a Value. \n
+ * - `Combine(const Value&, const Value&) -> Value` must be associative. It is applied in key order, so it
+ *   does not need to be commutative. \n
+ * - `Identity() -> Value` is the neutral element of Combine. It is optional: without it, a value-initialized
+ *   Value is used (which is right for sums, counts, and optionals). \n
+ * \n
+ * Here the Value is the best score, or tl::nullopt for a subtree without information.
+ * @tparam ScoreFn Function object, called as `score_fn(const NodeInfo&)`, returning a score comparable
+ * with `operator<`.
+ */
+template <typename ScoreFn>
+class MaxScore
+{
+public:
+    MaxScore() = default;
+    explicit MaxScore(ScoreFn score_fn) : m_score_fn{ std::move(score_fn) } {}
+
+    template <typename NodeInfo>
+    auto Lift(const NodeInfo& info) const
+    {
+        return tl::make_optional(m_score_fn(info));
+    }
+
+    template <typename Score>
+    auto Combine(const tl::optional<Score>& lhs, const tl::optional<Score>& rhs) const -> tl::optional<Score>
+    {
+        if (!lhs || (rhs && lhs.value() < rhs.value()))
+            return rhs;
+        return lhs;
+    }
+
+private:
+    ScoreFn m_score_fn{};
+};
+
 /**
  * Prefix Tree (Trie) structure. \n
  * \n
@@ -21,11 +155,64 @@
  * @tparam EdgeType Value represented in an edge. In the case of a string application, this value would
  * be a "char", and we would query on "vector of chars". `EdgeType` MUST be valid as a std::map key.
  * @tparam NodeInfo Information to be stored in nodes. Can be any type, include custom structures.
+ * @tparam Reducer Optional associative reduce over the information of each subtree (refer to `MaxScore` for
+ * the interface). When given, every node caches the reduction of its subtree, kept up to date along the path
+ * of every `Insert` and `Erase`, so `Aggregate` runs in O(depth).
  */
-template <typename EdgeType, typename NodeInfo>
+template <typename EdgeType, typename NodeInfo, typename Reducer = NoReducer>
 class PrefixTree
 {
 private:
+    static constexpr bool kAggregated = !std::is_same_v<Reducer, NoReducer>;
+    static constexpr std::size_t kPieces = 256;       // Pieces a Trie is split into by parallel traversals
+    static constexpr std::size_t kMinimumGrain = 256; // Keys below which a subtree is never split further
+    static constexpr char kMagic[4] = { 'P', 'T', 'R', 'E' }; // First bytes of a serialized Trie
+    static constexpr std::size_t kFormatVersion = 1;
+
+    template <typename R, typename = void>
+    struct ValueOf_
+    {
+        using type = int;
+    };
+    template <typename R>
+    struct ValueOf_<R, std::enable_if_t<!std::is_same_v<R, NoReducer>>>
+    {
+        using type = std::decay_t<decltype(std::declval<const R&>().Lift(std::declval<const NodeInfo&>()))>;
+    };
+
+    template <typename R>
+    struct IsMaxScore_ : std::false_type
+    {
+    };
+    template <typename ScoreFn>
+    struct IsMaxScore_<MaxScore<ScoreFn>> : std::true_type
+    {
+    };
+
+    template <typename T, typename = void>
+    struct IsEqualityComparable_ : std::false_type
+    {
+    };
+    template <typename T>
+    struct IsEqualityComparable_<T, std::void_t<decltype(std::declval<const T&>() == std::declval<const T&>())>>
+        : std::true_type
+    {
+    };
+
+public:
+    using Value = typename ValueOf_<Reducer>::type;
+
+private:
+    // Per-node annotations. Empty unless a Reducer is given, so plain Tries pay nothing for them.
+    struct NoAnnotation_
+    {
+    };
+    struct AggregateAnnotation_
+    {
+        Value m_aggregate{}; // Reduction of every information in this subtree
+    };
+    using Annotation_ = std::conditional_t<kAggregated, AggregateAnnotation_, NoAnnotation_>;
+
     /**
      * Node inside the Trie. \n
      * \n
@@ -34,18 +221,243 @@ private:
      * Inserting a Key into the Trie may create "intermediate" (non-terminal) nodes (refer to `Insert`). \n
      *
      */
-    class Node
+    class Node : public Annotation_
     {
+    public:
         using Edges = std::map<EdgeType, std::shared_ptr<Node>>;
 
-    public:
         Edges m_next{};                  // Possible paths from this node
         tl::optional<NodeInfo> m_info{}; // Information associated with this node
+        std::size_t m_count{};           // Keys in the subtree of this node, itself included
     };
     using Key = std::vector<EdgeType>;
 
+    template <typename, typename>
+    friend class AhoCorasick;
+
 public:
-    PrefixTree() : m_root{ std::make_shared<Node>() } {};
+    using Pattern = std::vector<PatternElement<EdgeType>>;
+
+    /**
+     * Read-only cursor over the edges of a Trie, one level at a time. \n
+     * \n
+     * A cursor starts above the root. `Open` moves down to the first edge of the current node, and `Up` goes back
+     * to the parent level. At each level, edges are visited in increasing order with `Next`, and `Seek` jumps
+     * forward to the first edge not smaller than a bound, in O(log fanout). This is the trie iterator
+     * interface of Leapfrog Triejoin. \n
+     * The Trie must outlive the cursor, and must not be modified while it is in use.
+     */
+    class Cursor
+    {
+    public:
+        explicit Cursor(const Node& root) : m_root{ &root } {}
+
+        /**
+         * Moves down to the first edge of the current node. The new level may be AtEnd if it has no edges.
+         */
+        auto Open() -> void
+        {
+            const auto& edges = Current_().m_next;
+            m_levels.push_back({ &edges, edges.begin() });
+        }
+
+        /**
+         * Moves back to the edge, at the previous level, that was current when `Open` was called.
+         */
+        auto Up() -> void { m_levels.pop_back(); }
+
+        /**
+         * Moves to the next edge of the current level.
+         */
+        auto Next() -> void { ++m_levels.back().m_position; }
+
+        /**
+         * Moves forward to the first edge of the current level not smaller than `bound`. Never moves backwards.
+         */
+        auto Seek(const EdgeType& bound) -> void
+        {
+            auto& level = m_levels.back();
+            if (level.m_position == level.m_edges->end() || !(level.m_position->first < bound))
+                return;
+            level.m_position = level.m_edges->lower_bound(bound);
+        }
+
+        /**
+         * Returns true if every edge of the current level was visited.
+         */
+        auto AtEnd() const -> bool { return m_levels.back().m_position == m_levels.back().m_edges->end(); }
+
+        /**
+         * Returns the current edge. REQUIRES: !AtEnd().
+         */
+        auto Key() const -> const EdgeType& { return m_levels.back().m_position->first; }
+
+        /**
+         * Returns the information of the node reached through the current edge, if it has any.
+         */
+        auto Info() const -> tl::optional<const NodeInfo&>
+        {
+            const auto& info = Current_().m_info;
+            if (info.has_value())
+                return info.value();
+            return tl::nullopt;
+        }
+
+        /**
+         * Returns the number of opened levels, i.e. the length of the key spelled by the current edges.
+         */
+        auto Depth() const -> std::size_t { return m_levels.size(); }
+
+    private:
+        struct Level
+        {
+            const typename Node::Edges* m_edges;
+            typename Node::Edges::const_iterator m_position;
+        };
+
+        auto Current_() const -> const Node&
+        {
+            if (m_levels.empty())
+                return *m_root;
+            return *m_levels.back().m_position->second;
+        }
+
+        const Node* m_root;
+        std::vector<Level> m_levels{};
+    };
+
+    /**
+     * Lookup of one key that descends one edge at a time, so that many lookups can be interleaved. \n
+     * \n
+     * Every `Step` follows one edge and prefetches the node it reaches, then returns. Running other lookups before
+     * the next `Step` gives that node time to arrive in the cache, instead of stalling on it. \n
+     * The Trie and the key must outlive the lookup, and the Trie must not be modified while it is in use.
+     */
+    class Lookup
+    {
+    public:
+        Lookup(const Node& root, const Key& key) : m_node{ &root }, m_key{ &key } {}
+
+        /**
+         * Follows the next edge of the key, and prefetches the node reached.
+         * @return True once the lookup is done, so that `Result` can be called.
+         */
+        auto Step() -> bool
+        {
+            if (Done())
+                return true;
+            auto it = m_node->m_next.find((*m_key)[m_depth]);
+            if (it == m_node->m_next.end())
+            {
+                m_node = nullptr;
+                return true;
+            }
+            m_node = it->second.get();
+            ++m_depth;
+            Prefetch_(m_node);
+            return Done();
+        }
+
+        /**
+         * Returns true once the key was found or is known to be missing.
+         */
+        auto Done() const -> bool { return !m_node || m_depth == m_key->size(); }
+
+        /**
+         * Returns the information associated with the key, or tl::nullopt. REQUIRES: Done().
+         */
+        auto Result() const -> tl::optional<const NodeInfo&>
+        {
+            if (!m_node || !m_node->m_info)
+                return tl::nullopt;
+            return m_node->m_info.value();
+        }
+
+    private:
+        static auto Prefetch_(const void* address) -> void
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(address);
+#else
+            static_cast<void>(address);
+#endif
+        }
+
+        const Node* m_node; // Node reached so far, or nullptr once the key is known to be missing
+        const Key* m_key;
+        std::size_t m_depth{};
+    };
+
+    PrefixTree() : PrefixTree(Reducer{}){};
+    explicit PrefixTree(Reducer reducer) : m_reducer{ std::move(reducer) } { m_root = NewNode_(); };
+
+    /**
+     * Builds a Trie holding every `keys[i]`, associated with `values[i]`, on a pool of `threads` workers. \n
+     * \n
+     * Keys are partitioned by their first edge, every top-level subtree is built by its own task, and the
+     * subtrees are then linked under the root. Tasks are submitted largest first, and idle workers steal them
+     * from busy ones, so skewed partitions still keep every worker busy. A subtree is allocated by the worker
+     * that builds it, so its nodes come from that thread's allocator arena. \n
+     * Repeated keys keep their last value, as with successive `Insert`s.
+     * @param keys Keys to insert.
+     * @param values Information of each key, in the same order.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     * @param reducer Reducer of the new Trie.
+     */
+    static auto ParallelBuild(const std::vector<Key>& keys, std::vector<NodeInfo> values, std::size_t threads,
+                              Reducer reducer = Reducer{}) -> PrefixTree
+    {
+        if (keys.size() != values.size())
+            throw std::invalid_argument("ParallelBuild needs exactly one value per key");
+
+        auto tree = PrefixTree{ std::move(reducer) };
+        auto partitions = std::map<EdgeType, std::vector<std::size_t>>{};
+        for (std::size_t index = 0; index < keys.size(); ++index)
+        {
+            if (keys[index].empty())
+            {
+                tree.m_size = 1;
+                tree.m_root->m_info = std::move(values[index]);
+            }
+            else
+            {
+                partitions[keys[index].front()].push_back(index);
+            }
+        }
+
+        // Each subtree is built in a Trie of its own, whose root only has that one edge
+        auto subtrees = std::vector<PrefixTree>{};
+        auto order = std::vector<std::pair<std::size_t, const std::vector<std::size_t>*>>{};
+        subtrees.reserve(partitions.size());
+        for (const auto& partition : partitions)
+        {
+            order.emplace_back(subtrees.size(), &partition.second);
+            subtrees.emplace_back(tree.m_reducer);
+        }
+        std::sort(order.begin(), order.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.second->size() > rhs.second->size(); });
+        {
+            auto pool = ThreadPool{ threads };
+            for (const auto& [subtree, indices] : order)
+            {
+                pool.Submit([&, subtree = subtree, indices = indices] {
+                    for (auto index : *indices)
+                        subtrees[subtree].Insert(keys[index], std::move(values[index]));
+                });
+            }
+            pool.Wait();
+        }
+
+        for (auto& subtree : subtrees)
+        {
+            tree.m_size += subtree.m_size;
+            tree.m_root->m_next.insert(tree.m_root->m_next.end(), *subtree.m_root->m_next.begin());
+        }
+        tree.m_root->m_count = tree.m_size;
+        if constexpr (kAggregated)
+            tree.m_root->m_aggregate = tree.Reduce_(*tree.m_root);
+        return tree;
+    }
 
     /**
      * Inserts a new node into the Trie. \n
@@ -64,7 +476,7 @@ public:
             if (!exists)
             {
                 // Intermediate node did not exist, so we must create it now
-                auto temp = std::make_shared<Node>();
+                auto temp = NewNode_();
                 current->m_next[edge_value] = temp;
                 current = temp;
             }
@@ -77,7 +489,13 @@ public:
         bool already_existed = current->m_info.has_value();
         current->m_info = std::move(info);
         if (!already_existed)
+        {
             ++m_size;
+            CountPath_(key, true);
+        }
+
+        if constexpr (kAggregated)
+            RefreshPath_(key);
     }
 
     /**
@@ -139,11 +557,1194 @@ public:
         auto node = GetNode_(key);
         auto& info = node->m_info;
         if (info)
+        {
             --m_size;
+            CountPath_(key, false);
+        }
         info = tl::nullopt;
+
+        if constexpr (kAggregated)
+            RefreshPath_(key);
+    }
+
+    /**
+     * Writes the Trie to `out`, in a compact binary format read back by `Deserialize`. \n
+     * \n
+     * The format holds a header (magic bytes, format version, number of nodes and keys, as varints), a bitmap of
+     * the nodes holding information, then every node in preorder: its number of edges as a varint, its
+     * information if any, then the label and subtree of every edge. \n
+     * Nodes left behind by `Erase` are not written. Cached reductions are not written either, and are recomputed
+     * by `Deserialize`.
+     * @param out Stream to write to, opened in binary mode. Throws std::runtime_error if writing fails.
+     * @param info_codec Writes NodeInfo. Refer to `TrivialCodec` for the interface.
+     * @param edge_codec Writes EdgeType. Refer to `TrivialCodec` for the interface.
+     */
+    template <typename InfoCodec = TrivialCodec<NodeInfo>, typename EdgeCodec = TrivialCodec<EdgeType>>
+    auto Serialize(std::ostream& out, const InfoCodec& info_codec = InfoCodec{},
+                   const EdgeCodec& edge_codec = EdgeCodec{}) const -> void
+    {
+        auto presence = std::vector<std::uint8_t>{};
+        std::size_t nodes = 0;
+        Presence_(*m_root, presence, nodes);
+
+        out.write(kMagic, sizeof(kMagic));
+        WriteVarint_(out, kFormatVersion);
+        WriteVarint_(out, nodes);
+        WriteVarint_(out, m_size);
+        out.write(reinterpret_cast<const char*>(presence.data()), static_cast<std::streamsize>(presence.size()));
+        Serialize_(*m_root, out, info_codec, edge_codec);
+        if (!out)
+            throw std::runtime_error("Failed to write PrefixTree");
+    }
+
+    /**
+     * Reads a Trie written by `Serialize`. \n
+     * \n
+     * Nodes are linked directly in preorder, without going through `Insert`, and every edge map is filled in
+     * increasing order, so loading is linear in the size of the stream.
+     * @param in Stream to read from, opened in binary mode. Throws std::runtime_error if it is not a valid Trie.
+     * @param info_codec Reads NodeInfo, written by the codec given to `Serialize`.
+     * @param edge_codec Reads EdgeType, written by the codec given to `Serialize`.
+     * @param reducer Reducer of the Trie read.
+     * @return Trie read.
+     */
+    template <typename InfoCodec = TrivialCodec<NodeInfo>, typename EdgeCodec = TrivialCodec<EdgeType>>
+    static auto Deserialize(std::istream& in, const InfoCodec& info_codec = InfoCodec{},
+                            const EdgeCodec& edge_codec = EdgeCodec{}, Reducer reducer = Reducer{}) -> PrefixTree
+    {
+        char magic[sizeof(kMagic)]{};
+        in.read(magic, sizeof(magic));
+        if (!in || !std::equal(std::begin(magic), std::end(magic), std::begin(kMagic)) ||
+            ReadVarint_(in) != kFormatVersion)
+            throw std::runtime_error("Not a serialized PrefixTree");
+
+        const auto nodes = ReadVarint_(in);
+        const auto size = ReadVarint_(in);
+        auto presence = std::vector<std::uint8_t>((nodes + 7) / 8);
+        in.read(reinterpret_cast<char*>(presence.data()), static_cast<std::streamsize>(presence.size()));
+        if (!in)
+            throw std::runtime_error("Truncated PrefixTree");
+
+        auto tree = PrefixTree{ std::move(reducer) };
+        std::size_t index = 0;
+        tree.m_root = tree.Deserialize_(in, presence, index, nodes, info_codec, edge_codec);
+        if (index != nodes || tree.m_root->m_count != size)
+            throw std::runtime_error("Corrupted PrefixTree");
+        tree.m_size = size;
+        return tree;
+    }
+
+    /**
+     * Returns a copy of this Trie without the nodes left behind by `Erase`. \n
+     * \n
+     * `Erase` only drops information, so the nodes of erased keys stay in the Trie. The copy keeps the keys,
+     * and only the nodes leading to them. Its nodes are allocated in depth-first order, so a subtree is laid
+     * out close together in memory.
+     * @return Compacted copy, sharing no node with this Trie.
+     */
+    auto Compacted() const -> PrefixTree
+    {
+        auto compacted = PrefixTree{ m_reducer };
+        auto root = compacted.Clone_(*m_root);
+        if (root)
+            compacted.m_root = std::move(root);
+        return compacted;
+    }
+
+    /**
+     * Returns the number of nodes, the root and the nodes left behind by `Erase` included. Linear in it.
+     */
+    auto NodeCount() const -> std::size_t
+    {
+        std::size_t count = 0;
+        auto pending = std::vector<const Node*>{ m_root.get() };
+        while (!pending.empty())
+        {
+            const auto* node = pending.back();
+            pending.pop_back();
+            ++count;
+            for (const auto& edge : node->m_next)
+                pending.push_back(edge.second.get());
+        }
+        return count;
+    }
+
+    /**
+     * Moves every key of `other` into this Trie. \n
+     * \n
+     * Both Tries are walked together, and the work done is proportional to the part they have in common:
+     * a subtree that only exists in `other` is moved over as a whole, without being copied or visited. \n
+     * Keys present in both Tries are resolved by `resolver`. `other` is left empty. \n
+     * Both Tries must use the same Reducer, as cached reductions of moved subtrees are kept as they are.
+     * @param other Trie to merge into this one.
+     * @param resolver Called as `resolver(const Key&, const NodeInfo& ours, NodeInfo&& theirs)` for every key
+     * present in both Tries, returning the NodeInfo to keep.
+     */
+    template <typename Resolver>
+    auto Merge(PrefixTree&& other, Resolver&& resolver) -> void
+    {
+        auto key = Key{};
+        std::size_t common = 0;
+        MergeNodes_(*m_root, *other.m_root, key, resolver, common);
+        m_size = m_size + other.m_size - common;
+
+        other.m_root = other.NewNode_();
+        other.m_size = 0;
+    }
+
+    /**
+     * Moves every key of `other` into this Trie. Keys present in both Tries take the information of `other`,
+     * as if they had been inserted. Refer to the overload with a resolver.
+     */
+    auto Merge(PrefixTree&& other) -> void
+    {
+        Merge(std::move(other), [](const Key&, const NodeInfo&, NodeInfo&& theirs) { return std::move(theirs); });
+    }
+
+    /**
+     * Merges every Trie of `trees` into a new one, on a pool of `threads` workers. \n
+     * \n
+     * The top-level edges of all the Tries are gathered first. An edge present in a single Trie has its whole
+     * subtree moved over, without being copied or visited. The subtrees of an edge present in several Tries are
+     * merged together by a task of their own, as `Merge` does, and tasks are spread over the workers. \n
+     * Keys present in several Tries are resolved in the order of `trees`: `ours` holds what was resolved so far
+     * from the earlier Tries. Every Trie of `trees` is left empty. They must all use the same Reducer.
+     * @param trees Tries to merge.
+     * @param resolver Called as `resolver(const Key&, const NodeInfo& ours, NodeInfo&& theirs)`, returning the
+     * NodeInfo to keep. Called concurrently for keys under different top-level edges.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     */
+    template <typename Resolver>
+    static auto ParallelMerge(std::vector<PrefixTree>&& trees, Resolver&& resolver, std::size_t threads)
+        -> PrefixTree
+    {
+        if (trees.empty())
+            return PrefixTree{};
+
+        auto result = PrefixTree{ trees.front().m_reducer };
+        auto& root = *result.m_root;
+        std::size_t total = 0;
+        std::size_t common = 0;
+        auto groups = std::map<EdgeType, std::vector<std::shared_ptr<Node>>>{};
+        for (auto& tree : trees)
+        {
+            total += tree.m_size;
+            auto& source = *tree.m_root;
+            if (source.m_info && root.m_info)
+            {
+                root.m_info = resolver(Key{}, root.m_info.value(), std::move(source.m_info.value()));
+                ++common;
+            }
+            else if (source.m_info)
+            {
+                root.m_info = std::move(source.m_info);
+            }
+            for (auto& [edge, child] : source.m_next)
+                groups[edge].push_back(std::move(child));
+
+            tree.m_root = tree.NewNode_();
+            tree.m_size = 0;
+        }
+
+        auto commons = std::vector<std::size_t>(groups.size());
+        {
+            auto pool = ThreadPool{ threads };
+            std::size_t index = 0;
+            for (auto it = groups.begin(); it != groups.end(); ++it, ++index)
+            {
+                if (it->second.size() < 2)
+                    continue;
+                pool.Submit([&result, &resolver, &commons, &children = it->second, edge = it->first, index] {
+                    auto key = Key{ edge };
+                    for (std::size_t i = 1; i < children.size(); ++i)
+                        result.MergeNodes_(*children.front(), *children[i], key, resolver, commons[index]);
+                });
+            }
+            pool.Wait();
+        }
+
+        for (auto& [edge, children] : groups)
+            root.m_next.emplace_hint(root.m_next.end(), edge, std::move(children.front()));
+        for (auto count : commons)
+            common += count;
+        result.m_size = total - common;
+        root.m_count = Count_(root);
+        if constexpr (kAggregated)
+            root.m_aggregate = result.Reduce_(root);
+        return result;
+    }
+
+    /**
+     * Merges every Trie of `trees` into a new one, on a pool of `threads` workers. Keys present in several
+     * Tries take the information of the last one, as if they had been inserted in order. Refer to the overload
+     * with a resolver.
+     */
+    static auto ParallelMerge(std::vector<PrefixTree>&& trees, std::size_t threads) -> PrefixTree
+    {
+        return ParallelMerge(
+            std::move(trees), [](const Key&, const NodeInfo&, NodeInfo&& theirs) { return std::move(theirs); },
+            threads);
+    }
+
+    /**
+     * Returns a Trie with the keys present in both this Trie and `other`, with the information of this one. \n
+     * \n
+     * Both Tries are walked in lockstep, and any subtree missing on one side is pruned without being visited.
+     */
+    auto Intersect(const PrefixTree& other) const -> PrefixTree
+    {
+        return Combine_(other, SetOperation_::Intersection);
+    }
+
+    /**
+     * Returns a Trie with the keys of this Trie that are not in `other`, with their information. \n
+     * \n
+     * Subtrees missing from `other` are copied whole, and subtrees missing from this Trie are never visited.
+     */
+    auto Difference(const PrefixTree& other) const -> PrefixTree
+    {
+        return Combine_(other, SetOperation_::Difference);
+    }
+
+    /**
+     * Returns a Trie with the keys present in exactly one of this Trie and `other`, with their information. \n
+     * \n
+     * Subtrees missing on one side are copied whole from the other one.
+     */
+    auto SymmetricDifference(const PrefixTree& other) const -> PrefixTree
+    {
+        return Combine_(other, SetOperation_::SymmetricDifference);
+    }
+
+    /**
+     * Streaming version of `Intersect`: visits the common keys in increasing order, building nothing.
+     * @param callback Called as `callback(const Key&, const NodeInfo& ours, const NodeInfo& theirs)`.
+     */
+    template <typename Callback>
+    auto ForEachIntersection(const PrefixTree& other, Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEachIntersection_(*m_root, *other.m_root, key, callback);
+    }
+
+    /**
+     * Streaming version of `Difference`: visits the keys missing from `other` in increasing order.
+     * @param callback Called as `callback(const Key&, const NodeInfo& ours)`.
+     */
+    template <typename Callback>
+    auto ForEachDifference(const PrefixTree& other, Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEachDifference_(*m_root, *other.m_root, key, callback);
+    }
+
+    /**
+     * Streaming version of `SymmetricDifference`: visits the keys present on a single side in increasing order.
+     * @param callback Called as `callback(const Key&, const NodeInfo&)`, with the information of the side
+     * holding the key.
+     */
+    template <typename Callback>
+    auto ForEachSymmetricDifference(const PrefixTree& other, Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEachSymmetricDifference_(*m_root, *other.m_root, key, callback);
+    }
+
+    /**
+     * Groups the keys by their first `depth` edges, and folds the information of each group. \n
+     * \n
+     * The Trie is walked once: down to `depth` to find the groups, then through the subtree of each group
+     * to fold it. No key outside the current path is materialized, and no temporary map is built. \n
+     * Keys shorter than `depth` belong to no group, and groups without keys are not emitted.
+     * @param depth Number of leading edges defining a group.
+     * @param init Initial accumulator of every group.
+     * @param reduce Called as `reduce(Accumulator, const NodeInfo&)` on every key of a group, in key order,
+     * returning the new accumulator.
+     * @param emit Called as `emit(const Key& group, Accumulator&&)` once per group, in group order.
+     */
+    template <typename Accumulator, typename Reduce, typename Emit>
+    auto GroupBy(std::size_t depth, const Accumulator& init, Reduce&& reduce, Emit&& emit) const -> void
+    {
+        auto key = Key{};
+        ForEachAtDepth_(*m_root, depth, key, [&](const Key& group, const Node& node) {
+            auto folded = FoldGroup_(node, init, reduce);
+            if (folded)
+                emit(group, std::move(folded.value()));
+        });
+    }
+
+    /**
+     * Parallel version of `GroupBy`: groups are folded on a pool of `threads` workers. \n
+     * \n
+     * The group roots are collected first, then split in contiguous batches across the workers. `reduce` may
+     * run concurrently on different groups, so it must not share mutable state between calls. `emit` is
+     * only called from the calling thread, in group order, once every group is folded.
+     * Refer to `GroupBy` for the parameters.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     */
+    template <typename Accumulator, typename Reduce, typename Emit>
+    auto ParallelGroupBy(std::size_t depth, const Accumulator& init, Reduce&& reduce, Emit&& emit,
+                         std::size_t threads) const -> void
+    {
+        auto groups = std::vector<std::pair<Key, const Node*>>{};
+        auto key = Key{};
+        ForEachAtDepth_(*m_root, depth, key,
+                        [&groups](const Key& group, const Node& node) { groups.emplace_back(group, &node); });
+
+        auto folded = std::vector<tl::optional<Accumulator>>(groups.size());
+        {
+            auto pool = ThreadPool{ threads };
+            // A few batches per worker, so uneven groups still spread the work
+            const auto batches = std::min(groups.size(), pool.Size() * 4);
+            for (std::size_t batch = 0; batch < batches; ++batch)
+            {
+                const auto first = groups.size() * batch / batches;
+                const auto last = groups.size() * (batch + 1) / batches;
+                pool.Submit([&, first, last] {
+                    for (auto index = first; index < last; ++index)
+                        folded[index] = FoldGroup_(*groups[index].second, init, reduce);
+                });
+            }
+            pool.Wait();
+        }
+
+        for (std::size_t index = 0; index < groups.size(); ++index)
+        {
+            if (folded[index])
+                emit(groups[index].first, std::move(folded[index].value()));
+        }
+    }
+
+    /**
+     * Calls `callback(const Key&, const NodeInfo&)` on every key, in increasing key order.
+     */
+    template <typename Callback>
+    auto ForEach(Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        ForEach_(*m_root, key, callback);
+    }
+
+    /**
+     * Calls `callback(const Key&, const NodeInfo&)` on every key, on a pool of `threads` workers. \n
+     * \n
+     * The Trie is split into subtrees of about the same number of keys, using the key count every node keeps,
+     * so a skewed fan-out still gives balanced tasks, which idle workers steal from busy ones. The callback
+     * runs concurrently, in no particular order, and must not modify the Trie.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     */
+    template <typename Callback>
+    auto ParallelForEach(Callback&& callback, std::size_t threads) const -> void
+    {
+        const auto pieces = Split_();
+        auto pool = ThreadPool{ threads };
+        for (const auto& piece : pieces)
+        {
+            pool.Submit([&piece, &callback] {
+                auto key = piece.m_key;
+                if (piece.m_whole)
+                    ForEach_(*piece.m_node, key, callback);
+                else
+                    callback(key, piece.m_node->m_info.value());
+            });
+        }
+        pool.Wait();
+    }
+
+    /**
+     * Folds every key, on a pool of `threads` workers, and returns `combine(...combine(identity, map(k1, i1))...,
+     * map(kn, in))` in key order. \n
+     * \n
+     * Splits the Trie as `ParallelForEach` does. Every subtree is folded on its own, then the partial results
+     * are combined in key order. The split only depends on the contents of the Trie, not on `threads`, so the
+     * result is deterministic, and equal to the sequential fold as long as `combine` is associative and
+     * `identity` is its identity.
+     * @param identity Identity of `combine`, and result of an empty Trie.
+     * @param map Called as `map(const Key&, const NodeInfo&)`, returns a T. Runs concurrently.
+     * @param combine Called as `combine(T, T)`, returns a T. Runs concurrently.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     */
+    template <typename T, typename Map, typename Combine>
+    auto ParallelReduce(const T& identity, Map&& map, Combine&& combine, std::size_t threads) const -> T
+    {
+        const auto pieces = Split_();
+        auto partials = std::vector<T>(pieces.size(), identity);
+        {
+            auto pool = ThreadPool{ threads };
+            for (std::size_t index = 0; index < pieces.size(); ++index)
+            {
+                pool.Submit([&, index] {
+                    const auto& piece = pieces[index];
+                    auto& partial = partials[index];
+                    auto fold = [&partial, &map, &combine](const Key& key, const NodeInfo& info) {
+                        partial = combine(std::move(partial), map(key, info));
+                    };
+                    auto key = piece.m_key;
+                    if (piece.m_whole)
+                        ForEach_(*piece.m_node, key, fold);
+                    else
+                        fold(key, piece.m_node->m_info.value());
+                });
+            }
+            pool.Wait();
+        }
+
+        auto result = identity;
+        for (auto& partial : partials)
+            result = combine(std::move(result), std::move(partial));
+        return result;
+    }
+
+    /**
+     * Returns a Cursor positioned above the root. Refer to `Cursor`.
+     */
+    auto MakeCursor() const -> Cursor { return Cursor{ *m_root }; }
+
+    /**
+     * Returns a Lookup of `key`, not started yet. Refer to `Lookup`.
+     */
+    auto MakeLookup(const Key& key) const -> Lookup { return Lookup{ *m_root, key }; }
+
+    /**
+     * Looks up many keys, keeping `group` lookups in flight and advancing them in turns, one edge at a time. \n
+     * \n
+     * A single lookup waits for every node it visits to be loaded from memory. Interleaving independent
+     * lookups overlaps those waits, which pays off for large Tries that do not fit in cache. \n
+     * Refer to `interleaved_lookup.hpp` to write the lookups as coroutines.
+     * @param keys Keys to look up.
+     * @param group Number of lookups in flight. One is equivalent to calling `Get` on every key.
+     * @return The information associated with every key, or tl::nullopt, in the order of `keys`.
+     */
+    auto MultiGet(const std::vector<Key>& keys, std::size_t group = 8) const
+        -> std::vector<tl::optional<const NodeInfo&>>
+    {
+        auto results = std::vector<tl::optional<const NodeInfo&>>(keys.size());
+        auto in_flight = std::vector<std::pair<std::size_t, Lookup>>{};
+        in_flight.reserve(std::max<std::size_t>(group, 1));
+        std::size_t next = 0;
+        for (; next < keys.size() && in_flight.size() < std::max<std::size_t>(group, 1); ++next)
+            in_flight.emplace_back(next, MakeLookup(keys[next]));
+
+        while (!in_flight.empty())
+        {
+            for (std::size_t i = 0; i < in_flight.size();)
+            {
+                auto& [index, lookup] = in_flight[i];
+                if (!lookup.Step())
+                {
+                    ++i;
+                    continue;
+                }
+                results[index] = lookup.Result();
+                if (next < keys.size())
+                {
+                    in_flight[i] = { next, MakeLookup(keys[next]) };
+                    ++next;
+                    ++i;
+                }
+                else
+                {
+                    in_flight[i] = std::move(in_flight.back());
+                    in_flight.pop_back();
+                }
+            }
+        }
+        return results;
+    }
+
+    /**
+     * Visits every key matching a positional pattern. \n
+     * \n
+     * Only keys with exactly `pattern.size()` edges can match. Exact positions are followed
+     * directly, ranges only visit the edges inside them, and only wildcard positions expand
+     * every edge of a node, so the work done is proportional to the part of the Trie the pattern
+     * can reach, not to the size of the Trie. \n
+     * Keys are visited in increasing order.
+     * @param pattern One `PatternElement` per key position.
+     * @param callback Called as `callback(const Key&, const NodeInfo&)` for every match.
+     */
+    template <typename Callback>
+    auto Match(const Pattern& pattern, Callback&& callback) const -> void
+    {
+        auto key = Key{};
+        key.reserve(pattern.size());
+        Match_(*m_root, pattern, key, callback);
+    }
+
+    /**
+     * Returns the reduction of the information of every key starting with `prefix`. \n
+     * \n
+     * Only available when the Trie has a `Reducer`. The reduction of every subtree is cached in its root,
+     * so this runs in O(depth), regardless of how many keys share the prefix.
+     * @param prefix Prefix of the keys to aggregate. The prefix itself is included, if present.
+     * @return Reduction of the matching keys, in key order, or the identity if there are none.
+     */
+    auto Aggregate(const Key& prefix) const -> Value
+    {
+        static_assert(kAggregated, "Aggregate requires a PrefixTree with a Reducer");
+
+        auto node = FindNode_(prefix);
+        if (!node)
+            return Identity_();
+        return node->m_aggregate;
+    }
+
+    /**
+     * Returns the `k` best scored keys starting with `prefix`, best first. \n
+     * \n
+     * Only available when the Trie's Reducer is a `MaxScore`. Runs a best-first search guided by the maximum
+     * score kept in every subtree, so it only touches O(k * depth) nodes (and their edges) instead of
+     * enumerating the whole subtree of `prefix`. Ties are broken by visiting order.
+     * @param prefix Prefix the keys must start with. The prefix itself is a candidate too.
+     * @param k Maximum number of keys to return.
+     * @return Up to `k` pairs of key and information, in decreasing order of score.
+     */
+    auto TopK(const Key& prefix, std::size_t k) const -> std::vector<std::pair<Key, NodeInfo>>
+    {
+        static_assert(IsMaxScore_<Reducer>::value, "TopK requires a PrefixTree with a MaxScore Reducer");
+        using Score = typename Value::value_type;
+
+        auto result = std::vector<std::pair<Key, NodeInfo>>{};
+        auto start = FindNode_(prefix);
+        if (!start || k == 0)
+            return result;
+
+        // Keys are rebuilt from parent links only for the entries that make it to the result
+        struct Visited
+        {
+            std::size_t parent;
+            const EdgeType* edge;
+        };
+        struct Candidate
+        {
+            Score score;
+            std::size_t order;   // Visiting order, breaks ties
+            std::size_t visited; // Index into `visited`
+            const Node* node;
+            bool is_key; // Whether this candidate is the key of `node` itself, or its whole subtree
+        };
+        auto worse = [](const Candidate& lhs, const Candidate& rhs) {
+            if (lhs.score < rhs.score || rhs.score < lhs.score)
+                return lhs.score < rhs.score;
+            return lhs.order > rhs.order;
+        };
+        auto candidates = std::priority_queue<Candidate, std::vector<Candidate>, decltype(worse)>{ worse };
+        auto visited = std::vector<Visited>{ { 0, nullptr } };
+        std::size_t order = 0;
+
+        if (start->m_aggregate)
+            candidates.push({ start->m_aggregate.value(), order++, 0, start, false });
+        while (!candidates.empty() && result.size() < k)
+        {
+            auto best = candidates.top();
+            candidates.pop();
+            if (best.is_key)
+            {
+                auto key = prefix;
+                auto suffix = std::vector<EdgeType>{};
+                for (auto index = best.visited; index != 0; index = visited[index].parent)
+                    suffix.push_back(*visited[index].edge);
+                key.insert(key.end(), suffix.rbegin(), suffix.rend());
+                result.emplace_back(std::move(key), best.node->m_info.value());
+                continue;
+            }
+
+            if (best.node->m_info)
+            {
+                auto score = m_reducer.Lift(best.node->m_info.value()).value();
+                candidates.push({ std::move(score), order++, best.visited, best.node, true });
+            }
+            for (const auto& [edge, child] : best.node->m_next)
+            {
+                if (!child->m_aggregate)
+                    continue;
+                visited.push_back({ best.visited, &edge });
+                candidates.push({ child->m_aggregate.value(), order++, visited.size() - 1, child.get(), false });
+            }
+        }
+        return result;
+    }
+
+private:
+    /**
+     * Returns the identity of the Reducer: `Identity()` if it has one, a value-initialized Value otherwise.
+     */
+    template <typename R = Reducer>
+    auto Identity_() const -> decltype(std::declval<const R&>().Identity())
+    {
+        return m_reducer.Identity();
+    }
+    template <typename... Ignored>
+    auto Identity_(Ignored...) const -> Value
+    {
+        return Value{};
+    }
+
+    /**
+     * Creates an empty node. Its cached reduction is the identity, so linking it does not change its ancestors.
+     */
+    auto NewNode_() const -> std::shared_ptr<Node>
+    {
+        auto node = std::make_shared<Node>();
+        if constexpr (kAggregated)
+            node->m_aggregate = Identity_();
+        return node;
+    }
+
+    /**
+     * Recomputes the cached reduction of `node` from its own information and its children's reductions.
+     */
+    auto Reduce_(const Node& node) const -> Value
+    {
+        auto value = node.m_info ? m_reducer.Lift(node.m_info.value()) : Identity_();
+        for (const auto& edge : node.m_next)
+            value = m_reducer.Combine(value, edge.second->m_aggregate);
+        return value;
+    }
+
+    /**
+     * Recomputes the cached reductions along the path of `key`, bottom-up. \n
+     * \n
+     * When Values can be compared, stops as soon as a node's reduction does not change, as no ancestor
+     * can change either.
+     */
+    auto RefreshPath_(const Key& key) -> void
+    {
+        auto path = std::vector<Node*>{ m_root.get() };
+        path.reserve(key.size() + 1);
+        for (const auto& edge_value : key)
+            path.push_back(path.back()->m_next.at(edge_value).get());
+
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            auto& node = **it;
+            auto value = Reduce_(node);
+            if constexpr (IsEqualityComparable_<Value>::value)
+            {
+                if (value == node.m_aggregate)
+                    break;
+            }
+            node.m_aggregate = std::move(value);
+        }
+    }
+
+    /**
+     * Updates the key counts along the path of `key`, which must exist, after it was added or removed.
+     */
+    auto CountPath_(const Key& key, bool added) -> void
+    {
+        auto current = m_root.get();
+        for (std::size_t depth = 0;; ++depth)
+        {
+            if (added)
+                ++current->m_count;
+            else
+                --current->m_count;
+            if (depth == key.size())
+                break;
+            current = current->m_next.at(key[depth]).get();
+        }
+    }
+
+    /**
+     * Part of the Trie visited by a single task: the subtree of `m_node`, or only its information if not
+     * `m_whole`. `m_key` is the key of `m_node`.
+     */
+    struct Piece_
+    {
+        Key m_key;
+        const Node* m_node;
+        bool m_whole;
+    };
+
+    /**
+     * Splits the keys into pieces of at most about `Size() / kPieces` keys, in key order. Subtrees small enough
+     * are whole pieces; larger ones are split below, their own information being a piece of its own.
+     */
+    auto Split_() const -> std::vector<Piece_>
+    {
+        const auto grain = std::max(kMinimumGrain, m_size / kPieces);
+        auto pieces = std::vector<Piece_>{};
+        auto key = Key{};
+        auto split = [&pieces, &key, grain](const auto& self, const Node& node) -> void {
+            if (node.m_count == 0)
+                return;
+            if (node.m_count <= grain)
+            {
+                pieces.push_back({ key, &node, true });
+                return;
+            }
+            if (node.m_info)
+                pieces.push_back({ key, &node, false });
+            for (const auto& [edge, child] : node.m_next)
+            {
+                key.push_back(edge);
+                self(self, *child);
+                key.pop_back();
+            }
+        };
+        split(split, *m_root);
+        return pieces;
+    }
+
+    /**
+     * Appends the presence bit of every node of the subtree of `node` to `presence`, in preorder, skipping nodes
+     * without keys below them. `nodes` counts the nodes visited.
+     */
+    static auto Presence_(const Node& node, std::vector<std::uint8_t>& presence, std::size_t& nodes) -> void
+    {
+        if (nodes % 8 == 0)
+            presence.push_back(0);
+        if (node.m_info)
+            presence.back() = static_cast<std::uint8_t>(presence.back() | (1U << (nodes % 8)));
+        ++nodes;
+        for (const auto& [edge, child] : node.m_next)
+        {
+            if (child->m_count > 0)
+                Presence_(*child, presence, nodes);
+        }
+    }
+
+    template <typename InfoCodec, typename EdgeCodec>
+    static auto Serialize_(const Node& node, std::ostream& out, const InfoCodec& info_codec,
+                           const EdgeCodec& edge_codec) -> void
+    {
+        const auto edges = static_cast<std::size_t>(std::count_if(
+            node.m_next.begin(), node.m_next.end(), [](const auto& edge) { return edge.second->m_count > 0; }));
+        WriteVarint_(out, edges);
+        if (node.m_info)
+            info_codec.Write(out, node.m_info.value());
+        for (const auto& [edge, child] : node.m_next)
+        {
+            if (child->m_count == 0)
+                continue;
+            edge_codec.Write(out, edge);
+            Serialize_(*child, out, info_codec, edge_codec);
+        }
+    }
+
+    /**
+     * Reads the subtree of node `index`, in preorder, and returns it with its counts and reduction computed.
+     */
+    template <typename InfoCodec, typename EdgeCodec>
+    auto Deserialize_(std::istream& in, const std::vector<std::uint8_t>& presence, std::size_t& index,
+                      std::size_t nodes, const InfoCodec& info_codec, const EdgeCodec& edge_codec) const
+        -> std::shared_ptr<Node>
+    {
+        if (index >= nodes)
+            throw std::runtime_error("Corrupted PrefixTree");
+        auto node = NewNode_();
+        const bool present = ((presence[index / 8] >> (index % 8)) & 1) != 0;
+        ++index;
+
+        const auto edges = ReadVarint_(in);
+        if (present)
+            node->m_info = info_codec.Read(in);
+        for (std::size_t i = 0; i < edges && in; ++i)
+        {
+            auto edge = edge_codec.Read(in);
+            auto child = Deserialize_(in, presence, index, nodes, info_codec, edge_codec);
+            node->m_next.emplace_hint(node->m_next.end(), std::move(edge), std::move(child));
+        }
+        if (!in)
+            throw std::runtime_error("Truncated PrefixTree");
+
+        node->m_count = Count_(*node);
+        if constexpr (kAggregated)
+            node->m_aggregate = Reduce_(*node);
+        return node;
+    }
+
+    /**
+     * Writes `value` as a LEB128 varint: 7 bits per byte, low bits first, the high bit set on all but the last.
+     */
+    static auto WriteVarint_(std::ostream& out, std::size_t value) -> void
+    {
+        while (value >= 0x80)
+        {
+            out.put(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.put(static_cast<char>(value));
+    }
+
+    static auto ReadVarint_(std::istream& in) -> std::size_t
+    {
+        std::size_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            const auto byte = in.get();
+            if (byte == std::istream::traits_type::eof())
+                throw std::runtime_error("Truncated PrefixTree");
+            value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        throw std::runtime_error("Corrupted PrefixTree");
+    }
+
+    /**
+     * Recomputes the key count of `node` from its own information and its children's counts.
+     */
+    static auto Count_(const Node& node) -> std::size_t
+    {
+        auto count = node.m_info ? std::size_t{ 1 } : std::size_t{ 0 };
+        for (const auto& edge : node.m_next)
+            count += edge.second->m_count;
+        return count;
+    }
+
+    /**
+     * Returns the node corresponding to `key`, or nullptr if there is no such node (terminal or not).
+     */
+    auto FindNode_(const Key& key) const -> const Node*
+    {
+        const Node* current = m_root.get();
+        for (const auto& edge_value : key)
+        {
+            auto it = current->m_next.find(edge_value);
+            if (it == current->m_next.end())
+                return nullptr;
+            current = it->second.get();
+        }
+        return current;
+    }
+
+    /**
+     * Recursive step of `Merge`: moves the contents of `source` into `target`, which both represent `key`. \n
+     * `common` counts the keys present in both.
+     */
+    template <typename Resolver>
+    auto MergeNodes_(Node& target, Node& source, Key& key, Resolver& resolver, std::size_t& common) -> void
+    {
+        if (source.m_info)
+        {
+            if (target.m_info)
+            {
+                target.m_info = resolver(key, target.m_info.value(), std::move(source.m_info.value()));
+                ++common;
+            }
+            else
+            {
+                target.m_info = std::move(source.m_info);
+            }
+        }
+
+        for (auto& [edge, child] : source.m_next)
+        {
+            auto it = target.m_next.lower_bound(edge);
+            if (it == target.m_next.end() || edge < it->first)
+            {
+                // Only `source` has this edge: the whole subtree changes owner
+                target.m_next.emplace_hint(it, edge, std::move(child));
+                continue;
+            }
+            key.push_back(edge);
+            MergeNodes_(*it->second, *child, key, resolver, common);
+            key.pop_back();
+        }
+
+        target.m_count = Count_(target);
+        if constexpr (kAggregated)
+            target.m_aggregate = Reduce_(target);
+    }
+
+    enum class SetOperation_
+    {
+        Intersection,
+        Difference,
+        SymmetricDifference
+    };
+
+    /**
+     * Walks the children of `ours` and `theirs` in lockstep, in increasing edge order. \n
+     * Calls `on_both(edge, ours_child, theirs_child)` for common edges, and `on_ours(edge, child)` or
+     * `on_theirs(edge, child)` for edges present on a single side.
+     */
+    template <typename OnBoth, typename OnOurs, typename OnTheirs>
+    static auto ForEachChildPair_(const Node& ours, const Node& theirs, OnBoth&& on_both, OnOurs&& on_ours,
+                                  OnTheirs&& on_theirs) -> void
+    {
+        auto lhs = ours.m_next.begin();
+        auto rhs = theirs.m_next.begin();
+        while (lhs != ours.m_next.end() || rhs != theirs.m_next.end())
+        {
+            if (rhs == theirs.m_next.end() || (lhs != ours.m_next.end() && lhs->first < rhs->first))
+            {
+                on_ours(lhs->first, *lhs->second);
+                ++lhs;
+            }
+            else if (lhs == ours.m_next.end() || rhs->first < lhs->first)
+            {
+                on_theirs(rhs->first, *rhs->second);
+                ++rhs;
+            }
+            else
+            {
+                on_both(lhs->first, *lhs->second, *rhs->second);
+                ++lhs;
+                ++rhs;
+            }
+        }
+    }
+
+    /**
+     * Visits every key of the subtree of `node` in increasing order. `key` holds the path to `node`.
+     */
+    template <typename Callback>
+    static auto ForEach_(const Node& node, Key& key, Callback& callback) -> void
+    {
+        if (node.m_info)
+            callback(key, node.m_info.value());
+        for (const auto& [edge, child] : node.m_next)
+        {
+            key.push_back(edge);
+            ForEach_(*child, key, callback);
+            key.pop_back();
+        }
+    }
+
+    /**
+     * Builds the result of a set operation between this Trie and `other`. Refer to `Intersect`.
+     */
+    auto Combine_(const PrefixTree& other, SetOperation_ operation) const -> PrefixTree
+    {
+        auto result = PrefixTree{ m_reducer };
+        auto root = result.CombineNodes_(m_root.get(), other.m_root.get(), operation);
+        if (root)
+            result.m_root = std::move(root);
+        return result;
+    }
+
+    /**
+     * Recursive step of `Combine_`, called on the result Trie. Either side may be missing (nullptr). \n
+     * Returns the combined node, or nullptr if it would hold no keys, so the result has no empty branches.
+     */
+    auto CombineNodes_(const Node* ours, const Node* theirs, SetOperation_ operation) -> std::shared_ptr<Node>
+    {
+        const bool keep_ours = operation != SetOperation_::Intersection;
+        const bool keep_theirs = operation == SetOperation_::SymmetricDifference;
+        if (!theirs)
+            return keep_ours ? Clone_(*ours) : nullptr;
+        if (!ours)
+            return keep_theirs ? Clone_(*theirs) : nullptr;
+
+        auto node = NewNode_();
+        const bool in_ours = ours->m_info.has_value();
+        const bool in_theirs = theirs->m_info.has_value();
+        if (in_ours && (in_theirs ? operation == SetOperation_::Intersection : keep_ours))
+            node->m_info = ours->m_info;
+        else if (in_theirs && !in_ours && keep_theirs)
+            node->m_info = theirs->m_info;
+        if (node->m_info)
+            ++m_size;
+
+        auto link = [&node](const EdgeType& edge, std::shared_ptr<Node> child) {
+            if (child)
+                node->m_next.emplace_hint(node->m_next.end(), edge, std::move(child));
+        };
+        ForEachChildPair_(
+            *ours, *theirs,
+            [&](const EdgeType& edge, const Node& lhs, const Node& rhs) {
+                link(edge, CombineNodes_(&lhs, &rhs, operation));
+            },
+            [&](const EdgeType& edge, const Node& child) {
+                if (keep_ours)
+                    link(edge, Clone_(child));
+            },
+            [&](const EdgeType& edge, const Node& child) {
+                if (keep_theirs)
+                    link(edge, Clone_(child));
+            });
+
+        if (!node->m_info && node->m_next.empty())
+            return nullptr;
+        node->m_count = Count_(*node);
+        if constexpr (kAggregated)
+            node->m_aggregate = Reduce_(*node);
+        return node;
+    }
+
+    /**
+     * Deep copies the subtree of `node` into this Trie, leaving out branches holding no information. \n
+     * Returns nullptr if the whole subtree holds no information.
+     */
+    auto Clone_(const Node& node) -> std::shared_ptr<Node>
+    {
+        auto copy = NewNode_();
+        if (node.m_info)
+        {
+            copy->m_info = node.m_info;
+            ++m_size;
+        }
+        for (const auto& [edge, child] : node.m_next)
+        {
+            auto child_copy = Clone_(*child);
+            if (child_copy)
+                copy->m_next.emplace_hint(copy->m_next.end(), edge, std::move(child_copy));
+        }
+
+        if (!copy->m_info && copy->m_next.empty())
+            return nullptr;
+        copy->m_count = Count_(*copy);
+        if constexpr (kAggregated)
+            copy->m_aggregate = Reduce_(*copy);
+        return copy;
+    }
+
+    /**
+     * Recursive step of `ForEachIntersection`.
+     */
+    template <typename Callback>
+    static auto ForEachIntersection_(const Node& ours, const Node& theirs, Key& key, Callback& callback) -> void
+    {
+        if (ours.m_info && theirs.m_info)
+            callback(key, ours.m_info.value(), theirs.m_info.value());
+        ForEachChildPair_(
+            ours, theirs,
+            [&](const EdgeType& edge, const Node& lhs, const Node& rhs) {
+                key.push_back(edge);
+                ForEachIntersection_(lhs, rhs, key, callback);
+                key.pop_back();
+            },
+            [](const EdgeType&, const Node&) {},
+            [](const EdgeType&, const Node&) {});
+    }
+
+    /**
+     * Recursive step of `ForEachDifference`.
+     */
+    template <typename Callback>
+    static auto ForEachDifference_(const Node& ours, const Node& theirs, Key& key, Callback& callback) -> void
+    {
+        if (ours.m_info && !theirs.m_info)
+            callback(key, ours.m_info.value());
+        ForEachChildPair_(
+            ours, theirs,
+            [&](const EdgeType& edge, const Node& lhs, const Node& rhs) {
+                key.push_back(edge);
+                ForEachDifference_(lhs, rhs, key, callback);
+                key.pop_back();
+            },
+            [&](const EdgeType& edge, const Node& child) {
+                key.push_back(edge);
+                ForEach_(child, key, callback);
+                key.pop_back();
+            },
+            [](const EdgeType&, const Node&) {});
+    }
+
+    /**
+     * Recursive step of `ForEachSymmetricDifference`.
+     */
+    template <typename Callback>
+    static auto ForEachSymmetricDifference_(const Node& ours, const Node& theirs, Key& key, Callback& callback)
+        -> void
+    {
+        if (ours.m_info && !theirs.m_info)
+            callback(key, ours.m_info.value());
+        else if (theirs.m_info && !ours.m_info)
+            callback(key, theirs.m_info.value());
+
+        auto visit_whole = [&](const EdgeType& edge, const Node& child) {
+            key.push_back(edge);
+            ForEach_(child, key, callback);
+            key.pop_back();
+        };
+        ForEachChildPair_(
+            ours, theirs,
+            [&](const EdgeType& edge, const Node& lhs, const Node& rhs) {
+                key.push_back(edge);
+                ForEachSymmetricDifference_(lhs, rhs, key, callback);
+                key.pop_back();
+            },
+            visit_whole, visit_whole);
+    }
+
+    /**
+     * Calls `callback(key, node)` for every node at `depth` edges below `node`, in key order. `key` holds the path
+     * to `node`.
+     */
+    template <typename Callback>
+    static auto ForEachAtDepth_(const Node& node, std::size_t depth, Key& key, Callback&& callback) -> void
+    {
+        if (key.size() == depth)
+        {
+            callback(key, node);
+            return;
+        }
+        for (const auto& [edge, child] : node.m_next)
+        {
+            key.push_back(edge);
+            ForEachAtDepth_(*child, depth, key, callback);
+            key.pop_back();
+        }
+    }
+
+    /**
+     * Folds the information of every key in the subtree of `node`, in key order. \n
+     * Returns tl::nullopt if the subtree holds no information.
+     */
+    template <typename Accumulator, typename Reduce>
+    static auto FoldGroup_(const Node& node, const Accumulator& init, Reduce& reduce) -> tl::optional<Accumulator>
+    {
+        auto folded = tl::optional<Accumulator>{};
+        auto fold = [&](const Node& current, auto& self) -> void {
+            if (current.m_info)
+                folded = reduce(folded ? std::move(folded.value()) : init, current.m_info.value());
+            for (const auto& edge : current.m_next)
+                self(*edge.second, self);
+        };
+        fold(node, fold);
+        return folded;
+    }
+
+    /**
+     * Recursive step of `Match`. `key` holds the edges taken from the root to `node`.
+     */
+    template <typename Callback>
+    static auto Match_(const Node& node, const Pattern& pattern, Key& key, Callback& callback) -> void
+    {
+        const auto depth = key.size();
+        if (depth == pattern.size())
+        {
+            if (node.m_info.has_value())
+                callback(key, node.m_info.value());
+            return;
+        }
+
+        const auto visit = [&](const auto& edge) {
+            key.push_back(edge.first);
+            Match_(*edge.second, pattern, key, callback);
+            key.pop_back();
+        };
+
+        const auto& element = pattern[depth];
+        switch (element.GetKind())
+        {
+        case PatternElement<EdgeType>::Kind::Exact:
+        {
+            auto it = node.m_next.find(element.Low());
+            if (it != node.m_next.end())
+                visit(*it);
+            break;
+        }
+        case PatternElement<EdgeType>::Kind::Range:
+        {
+            if (element.High() < element.Low())
+                break;
+            auto last = node.m_next.upper_bound(element.High());
+            for (auto it = node.m_next.lower_bound(element.Low()); it != last; ++it)
+                visit(*it);
+            break;
+        }
+        case PatternElement<EdgeType>::Kind::Any:
+            for (const auto& edge : node.m_next)
+                visit(edge);
+            break;
+        }
     }
 
-private:
     /**
      * Returns a reference to an existing node in the Trie. \n
      * \n
@@ -162,5 +1763,6 @@ private:
 
 private:
     std::shared_ptr<Node> m_root{};
+    Reducer m_reducer{};
     std::size_t m_size{}; // Number of terminal nodes in Trie. It may also be interesting to keep number of ALL nodes.
 };
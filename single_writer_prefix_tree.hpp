@@ -0,0 +1,270 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+#include "tl_optional.hpp"
+
+/**
+ * Prefix Tree (Trie) for a single writer thread and any number of reader threads. \n
+ * \n
+ * The writer applies a batch of `Insert` and `Erase` calls to a private version, then `Publish`es it with a
+ * single atomic store of the root. Readers load the published root once, and traverse it with plain loads:
+ * nodes are never modified once published. \n
+ * The first time a batch reaches a published node, the writer copies it, so a batch only copies the paths it
+ * touches, each node at most once, and shares every other subtree with the published version. Later writes of
+ * the same batch to that path modify the copies in place. \n
+ * A version replaced by `Publish` is retired to an EpochManager, and freed once no reader can still hold it.
+ * Nodes it shares with newer versions are reference counted, so only the ones it owned are freed. \n
+ * Like PersistentPrefixTree, `Erase` prunes the nodes it leaves without information and without edges.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree.
+ */
+template <typename EdgeType, typename NodeInfo>
+class SingleWriterPrefixTree
+{
+private:
+    struct Node
+    {
+        std::map<EdgeType, std::shared_ptr<Node>> m_next{};
+        tl::optional<NodeInfo> m_info{};
+        std::uint64_t m_batch{}; // Batch that created the node. Nodes of earlier batches may be published.
+    };
+
+    struct Version
+    {
+        std::shared_ptr<const Node> m_root;
+        std::size_t m_size;
+    };
+
+public:
+    using Key = std::vector<EdgeType>;
+
+    /**
+     * Read-only access to a published version, valid during the `Read` callback it is passed to.
+     */
+    class View
+    {
+    public:
+        /**
+         * Returns the information associated with `key`, or tl::nullopt. Must not escape the `Read` callback.
+         */
+        auto Get(const Key& key) const -> tl::optional<const NodeInfo&>
+        {
+            const Node* current = m_version.m_root.get();
+            for (const auto& edge_value : key)
+            {
+                auto it = current->m_next.find(edge_value);
+                if (it == current->m_next.end())
+                    return tl::nullopt;
+                current = it->second.get();
+            }
+            if (!current->m_info)
+                return tl::nullopt;
+            return current->m_info.value();
+        }
+
+        /**
+         * Returns true if `key` is present in this version.
+         */
+        auto Contains(const Key& key) const -> bool { return Get(key).has_value(); }
+
+        /**
+         * Calls `callback(const Key&, const NodeInfo&)` on every key of this version, in key order.
+         */
+        template <typename Callback>
+        auto ForEach(Callback&& callback) const -> void
+        {
+            auto key = Key{};
+            ForEach_(*m_version.m_root, key, callback);
+        }
+
+        /**
+         * Returns the number of keys in this version.
+         */
+        auto Size() const -> std::size_t { return m_version.m_size; }
+
+    private:
+        friend class SingleWriterPrefixTree;
+        explicit View(const Version& version) : m_version{ version } {}
+
+        template <typename Callback>
+        static auto ForEach_(const Node& node, Key& key, Callback& callback) -> void
+        {
+            if (node.m_info)
+                callback(key, node.m_info.value());
+            for (const auto& [edge, child] : node.m_next)
+            {
+                key.push_back(edge);
+                ForEach_(*child, key, callback);
+                key.pop_back();
+            }
+        }
+
+        const Version& m_version;
+    };
+
+    SingleWriterPrefixTree()
+        : m_pending{ std::make_shared<Node>() }, m_published{ new Version{ m_pending, 0 } }, m_batch{ 1 }
+    {
+    }
+
+    SingleWriterPrefixTree(const SingleWriterPrefixTree&) = delete;
+    SingleWriterPrefixTree& operator=(const SingleWriterPrefixTree&) = delete;
+
+    /**
+     * Frees the published version. No reader may be running anymore.
+     */
+    ~SingleWriterPrefixTree() { delete m_published.load(std::memory_order_relaxed); }
+
+    // Writer thread
+
+    /**
+     * Inserts or overwrites a key in the pending batch. Refer to `PrefixTree::Insert`. \n
+     * Readers see it once the batch is published. Writer thread only.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        auto current = Own_(m_pending);
+        for (const auto& edge_value : key)
+        {
+            auto& child = current->m_next[edge_value];
+            if (!child)
+                child = NewNode_();
+            current = Own_(child);
+        }
+        if (!current->m_info)
+            ++m_pending_size;
+        current->m_info = std::move(info);
+    }
+
+    /**
+     * Erases a key in the pending batch. Throws if it is not present in the pending batch. Writer thread only.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        // Checked first, so that a missing key does not copy anything
+        if (!ContainsPending_(key))
+            throw std::runtime_error("Erasing key not present in Trie");
+
+        auto path = std::vector<Node*>{ Own_(m_pending) };
+        for (const auto& edge_value : key)
+            path.push_back(Own_(path.back()->m_next.at(edge_value)));
+        path.back()->m_info = tl::nullopt;
+        --m_pending_size;
+
+        for (auto depth = key.size(); depth > 0; --depth)
+        {
+            if (path[depth]->m_info || !path[depth]->m_next.empty())
+                break;
+            path[depth - 1]->m_next.erase(key[depth - 1]);
+        }
+    }
+
+    /**
+     * Atomically makes every write since the last call visible to readers. Writer thread only.
+     */
+    auto Publish() -> void
+    {
+        auto previous = m_published.exchange(new Version{ m_pending, m_pending_size }, std::memory_order_acq_rel);
+        m_epochs.Retire(previous);
+        ++m_batch;
+    }
+
+    // Reader threads
+
+    /**
+     * Calls `callback(const View&)` on the currently published version, and returns its result. \n
+     * \n
+     * The root is loaded once, so everything the callback reads comes from the same version, however many
+     * versions the writer publishes meanwhile.
+     */
+    template <typename Callback>
+    auto Read(Callback&& callback) const -> decltype(auto)
+    {
+        auto guard = m_epochs.Pin();
+        return callback(View{ *m_published.load(std::memory_order_acquire) });
+    }
+
+    /**
+     * Returns a copy of the published information associated with `key`, or tl::nullopt.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        return Read([&key](const View& view) -> tl::optional<NodeInfo> {
+            auto info = view.Get(key);
+            if (!info)
+                return tl::nullopt;
+            return info.value();
+        });
+    }
+
+    /**
+     * Returns true if `key` is present in the published version.
+     */
+    auto Contains(const Key& key) const -> bool
+    {
+        return Read([&key](const View& view) { return view.Contains(key); });
+    }
+
+    /**
+     * Returns the number of keys in the published version.
+     */
+    auto Size() const -> std::size_t
+    {
+        return Read([](const View& view) { return view.Size(); });
+    }
+
+    /**
+     * Returns true if the published version holds no keys.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+private:
+    auto NewNode_() const -> std::shared_ptr<Node>
+    {
+        auto node = std::make_shared<Node>();
+        node->m_batch = m_batch;
+        return node;
+    }
+
+    /**
+     * Makes `node` private to the pending batch, copying it if it may be published, and returns it.
+     */
+    auto Own_(std::shared_ptr<Node>& node) const -> Node*
+    {
+        if (node->m_batch != m_batch)
+        {
+            node = std::make_shared<Node>(*node);
+            node->m_batch = m_batch;
+        }
+        return node.get();
+    }
+
+    auto ContainsPending_(const Key& key) const -> bool
+    {
+        const Node* current = m_pending.get();
+        for (const auto& edge_value : key)
+        {
+            auto it = current->m_next.find(edge_value);
+            if (it == current->m_next.end())
+                return false;
+            current = it->second.get();
+        }
+        return current->m_info.has_value();
+    }
+
+private:
+    mutable EpochManager m_epochs{}; // Declared first, so it frees retired versions last
+    std::shared_ptr<Node> m_pending;  // Root of the batch being written
+    std::size_t m_pending_size{};
+    std::atomic<Version*> m_published;
+    std::uint64_t m_batch; // Nodes of this batch are private to the writer
+};
@@ -0,0 +1,67 @@
+#include "catch.hpp"
+
+#include <string>
+#include <tuple>
+
+#include "../aho_corasick.hpp"
+
+namespace
+{
+    auto ToKey(const std::string& string) -> std::vector<char> { return { string.begin(), string.end() }; }
+
+    using Match = std::tuple<std::size_t, std::size_t, int>; // begin, length, rule
+} // namespace
+
+SCENARIO("A Trie of signatures can be compiled into a multi-pattern scanner")
+{
+    GIVEN("A Trie with overlapping signatures")
+    {
+        auto rules = PrefixTree<char, int>{};
+        rules.Insert(ToKey("he"), 1);
+        rules.Insert(ToKey("she"), 2);
+        rules.Insert(ToKey("his"), 3);
+        rules.Insert(ToKey("hers"), 4);
+        auto scanner = AhoCorasick<char, int>::Compile(rules);
+
+        auto matches = std::vector<Match>{};
+        auto collect = [&matches](std::size_t begin, std::size_t length, int rule) {
+            matches.emplace_back(begin, length, rule);
+        };
+
+        WHEN("We scan a text in one pass")
+        {
+            scanner.Scan(std::string{ "ushers" }, collect);
+            THEN("Every occurrence is reported, including patterns that are suffixes of others")
+            {
+                REQUIRE(matches == std::vector<Match>{ { 1, 3, 2 }, { 2, 2, 1 }, { 2, 4, 4 } });
+            }
+        }
+
+        WHEN("We scan the same text split in chunks")
+        {
+            const auto text = std::string{ "ahishers" };
+            auto state = AhoCorasick<char, int>::ScanState{};
+            for (std::size_t begin = 0; begin < text.size(); begin += 3)
+            {
+                const auto end = std::min(begin + 3, text.size());
+                scanner.Scan(text.begin() + static_cast<std::ptrdiff_t>(begin),
+                             text.begin() + static_cast<std::ptrdiff_t>(end), state, collect);
+            }
+            THEN("Matches spanning chunk boundaries are found at their stream offsets")
+            {
+                REQUIRE(matches == std::vector<Match>{ { 1, 3, 3 }, { 3, 3, 2 }, { 4, 2, 1 }, { 4, 4, 4 } });
+                REQUIRE(state.m_position == text.size());
+            }
+        }
+
+        WHEN("The Trie changes after compiling")
+        {
+            rules.Erase(ToKey("he"));
+            scanner.Scan(std::string{ "he" }, collect);
+            THEN("The scanner is not affected")
+            {
+                REQUIRE(matches == std::vector<Match>{ { 0, 2, 1 } });
+            }
+        }
+    }
+}
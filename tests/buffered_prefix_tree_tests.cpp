@@ -0,0 +1,72 @@
+#include "catch.hpp"
+
+#include <thread>
+
+#include "../buffered_prefix_tree.hpp"
+
+SCENARIO("Writes can be buffered per thread and merged into a shared Trie")
+{
+    GIVEN("A buffered Trie")
+    {
+        struct Sum
+        {
+            auto Lift(int info) const -> long { return info; }
+            auto Combine(long lhs, long rhs) const -> long { return lhs + rhs; }
+        };
+        auto tree = BufferedPrefixTree<int, int, Sum>{ 4 };
+
+        WHEN("A thread inserts fewer keys than the threshold")
+        {
+            tree.Insert({ 1, 2 }, 10);
+            tree.Insert({ 1, 3 }, 20);
+            THEN("It reads its own writes, and so do other threads")
+            {
+                REQUIRE(tree.Get({ 1, 2 }) == 10);
+                auto seen = tl::optional<int>{};
+                std::thread{ [&] { seen = tree.Get({ 1, 3 }); } }.join();
+                REQUIRE(seen == 20);
+                REQUIRE(tree.Size() == 2);
+            }
+            THEN("Newer buffered writes hide flushed ones")
+            {
+                tree.Flush();
+                tree.Insert({ 1, 2 }, 30);
+                REQUIRE(tree.Get({ 1, 2 }) == 30);
+                REQUIRE(tree.Read([](const auto& shared) { return shared.Aggregate({ 1 }); }) == 50);
+            }
+            THEN("Erasing flushes first")
+            {
+                tree.Erase({ 1, 2 });
+                REQUIRE(tree.Contains({ 1, 2 }) == false);
+                REQUIRE(tree.Size() == 1);
+                REQUIRE_THROWS(tree.Erase({ 1, 2 }));
+            }
+        }
+
+        WHEN("Several producers insert concurrently")
+        {
+            constexpr int kProducers = 4;
+            constexpr int kKeys = 500;
+            auto producers = std::vector<std::thread>{};
+            for (int id = 0; id < kProducers; ++id)
+            {
+                producers.emplace_back([&tree, id] {
+                    for (int i = 0; i < kKeys; ++i)
+                        tree.Insert({ id, i }, i);
+                });
+            }
+            for (auto& producer : producers)
+                producer.join();
+
+            THEN("Every key is found, buffered or merged, and counted once after a flush")
+            {
+                REQUIRE(tree.Get({ 2, 499 }) == 499);
+                REQUIRE(tree.Get({ 3, 0 }) == 0);
+                tree.Flush();
+                REQUIRE(tree.Size() == kProducers * kKeys);
+                REQUIRE(tree.Read([](const auto& shared) { return shared.Aggregate({}); }) ==
+                        kProducers * (kKeys * (kKeys - 1) / 2));
+            }
+        }
+    }
+}
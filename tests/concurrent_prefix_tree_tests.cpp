@@ -0,0 +1,118 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include "../concurrent_prefix_tree.hpp"
+
+SCENARIO("A sharded Trie can be used from several threads")
+{
+    GIVEN("An empty sharded Trie")
+    {
+        auto tree = ConcurrentPrefixTree<int, int>{ 8 };
+        REQUIRE(tree.Empty());
+
+        WHEN("We use it from a single thread")
+        {
+            tree.Insert({ 1, 2 }, 10);
+            tree.Insert({ 1, 3 }, 20);
+            tree.Insert({ 1, 2 }, 30);
+            THEN("It behaves like a PrefixTree")
+            {
+                REQUIRE(tree.Size() == 2);
+                REQUIRE(tree.Get({ 1, 2 }) == 30);
+                REQUIRE(tree.Contains({ 1 }) == false);
+                tree.Erase({ 1, 2 });
+                REQUIRE(tree.Contains({ 1, 2 }) == false);
+                REQUIRE_THROWS(tree.Erase({ 1, 2 }));
+                REQUIRE(tree.Size() == 1);
+            }
+            THEN("Keys sharing the shard prefix can be queried together")
+            {
+                auto count = tree.ReadShard({ 1 }, [](const auto& shard) {
+                    std::size_t keys = 0;
+                    shard.Match({ 1, PatternElement<int>::Any() }, [&keys](const auto&, int) { ++keys; });
+                    return keys;
+                });
+                REQUIRE(count == 2);
+            }
+        }
+
+        WHEN("Several threads insert and read concurrently")
+        {
+            constexpr int kThreads = 4;
+            constexpr int kKeys = 500;
+            auto workers = std::vector<std::thread>{};
+            for (int id = 0; id < kThreads; ++id)
+            {
+                workers.emplace_back([&tree, id] {
+                    for (int i = 0; i < kKeys; ++i)
+                    {
+                        tree.Insert({ i % 17, id, i }, i);
+                        tree.Get({ i % 17, (id + 1) % kThreads, i });
+                    }
+                });
+            }
+            for (auto& worker : workers)
+                worker.join();
+
+            THEN("Every insertion is visible")
+            {
+                REQUIRE(tree.Size() == kThreads * kKeys);
+                for (int id = 0; id < kThreads; ++id)
+                    REQUIRE(tree.Get({ 7, id, 7 }) == 7);
+            }
+        }
+    }
+}
+
+SCENARIO("Shards can be compacted after erases")
+{
+    GIVEN("A sharded Trie with erased keys")
+    {
+        auto tree = ConcurrentPrefixTree<int, int>{ 4 };
+        for (int i = 0; i < 200; ++i)
+            tree.Insert({ i % 8, i, i }, i);
+        for (int i = 0; i < 200; i += 2)
+            tree.Erase({ i % 8, i, i });
+        auto nodes = [&tree] {
+            std::size_t count = 0;
+            for (int prefix = 0; prefix < 8; ++prefix)
+                count += tree.ReadShard({ prefix }, [](const auto& shard) { return shard.NodeCount(); });
+            return count;
+        };
+        const auto before = nodes();
+
+        WHEN("Shards are compacted on the calling thread")
+        {
+            THEN("Nodes of erased keys are freed, and keys are kept")
+            {
+                REQUIRE(tree.CompactShards(1000) == 0);
+                REQUIRE(tree.CompactShards() > 0);
+                REQUIRE(nodes() < before);
+                REQUIRE(tree.Size() == 100);
+                REQUIRE(tree.Get({ 1, 9, 9 }) == 9);
+                REQUIRE(tree.Contains({ 0, 8, 8 }) == false);
+                REQUIRE(tree.CompactShards() == 0);
+            }
+        }
+
+        WHEN("A background compactor runs while the Trie is read")
+        {
+            tree.StartCompactor(std::chrono::milliseconds{ 1 }, 1);
+            bool consistent = true;
+            while (tree.ReadShard({ 0 }, [](const auto& shard) { return shard.NodeCount(); }) > 50)
+            {
+                for (int i = 1; i < 200; i += 2)
+                    consistent = consistent && tree.Get({ i % 8, i, i }) == i;
+            }
+            tree.StopCompactor();
+            THEN("Cold shards end up compacted")
+            {
+                REQUIRE(consistent);
+                REQUIRE(nodes() < before);
+                REQUIRE(tree.Size() == 100);
+            }
+        }
+    }
+}
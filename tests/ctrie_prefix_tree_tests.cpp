@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <set>
+#include <thread>
+
+#include "../ctrie_prefix_tree.hpp"
+
+SCENARIO("A concurrent hash trie takes consistent snapshots")
+{
+    GIVEN("A Ctrie with some keys")
+    {
+        auto tree = CtriePrefixTree<int, int>{};
+        for (int i = 0; i < 1000; ++i)
+            tree.Insert({ i, i % 3 }, i);
+
+        WHEN("We read, overwrite and erase keys")
+        {
+            tree.Insert({ 5, 2 }, -5);
+            tree.Erase({ 7, 1 });
+            THEN("It behaves like a PrefixTree")
+            {
+                REQUIRE(tree.Size() == 999);
+                REQUIRE(tree.Get({ 5, 2 }) == -5);
+                REQUIRE(tree.Get({ 6, 0 }) == 6);
+                REQUIRE(tree.Contains({ 7, 1 }) == false);
+                REQUIRE(tree.Contains({ 6 }) == false);
+                REQUIRE_THROWS(tree.Erase({ 7, 1 }));
+            }
+        }
+
+        WHEN("We take a snapshot and keep writing")
+        {
+            auto snapshot = tree.Snapshot();
+            for (int i = 0; i < 1000; i += 2)
+                tree.Erase({ i, i % 3 });
+            tree.Insert({ 1, 1 }, -1);
+            tree.Insert({ 2000 }, 2000);
+
+            THEN("The snapshot is unaffected, and the Trie sees every write")
+            {
+                REQUIRE(snapshot.Size() == 1000);
+                REQUIRE(snapshot.Get({ 0, 0 }) == 0);
+                REQUIRE(snapshot.Get({ 1, 1 }) == 1);
+                REQUIRE(snapshot.Contains({ 2000 }) == false);
+
+                REQUIRE(tree.Size() == 501);
+                REQUIRE(tree.Contains({ 0, 0 }) == false);
+                REQUIRE(tree.Get({ 1, 1 }) == -1);
+                REQUIRE(tree.Get({ 2000 }) == 2000);
+                REQUIRE(tree.Snapshot().Size() == 501);
+            }
+        }
+    }
+
+    GIVEN("A Ctrie filled by a writer thread")
+    {
+        constexpr int kKeys = 5000;
+        auto tree = CtriePrefixTree<int, int>{};
+        auto writer = std::thread{ [&tree] {
+            for (int i = 0; i < kKeys; ++i)
+                tree.Insert({ i }, i);
+        } };
+
+        WHEN("We take snapshots while it writes")
+        {
+            auto consistent = true;
+            for (int attempt = 0; attempt < 20; ++attempt)
+            {
+                // Keys are inserted in order, so a consistent snapshot holds exactly the first ones
+                auto snapshot = tree.Snapshot();
+                auto seen = std::set<int>{};
+                snapshot.ForEach([&seen](const std::vector<int>& key, int) { seen.insert(key.front()); });
+                if (!seen.empty() && (*seen.begin() != 0 || *seen.rbegin() != static_cast<int>(seen.size()) - 1))
+                    consistent = false;
+            }
+            writer.join();
+
+            THEN("Every snapshot holds a prefix of the insertions")
+            {
+                REQUIRE(consistent);
+                REQUIRE(tree.Size() == kKeys);
+                REQUIRE(tree.Snapshot().Size() == kKeys);
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include "catch.hpp"
+
+#include "../flat_prefix_tree.hpp"
+
+SCENARIO("A Trie can be frozen into flat arrays")
+{
+    GIVEN("A Trie with nested keys")
+    {
+        auto tree = PrefixTree<char, int>{};
+        tree.Insert({ 'a' }, 1);
+        tree.Insert({ 'a', 'b' }, 2);
+        tree.Insert({ 'a', 'c', 'd' }, 3);
+        tree.Insert({ 'b' }, 4);
+        tree.Insert({}, 0);
+
+        WHEN("It is frozen")
+        {
+            auto flat = FlatPrefixTree<char, int>::From(tree);
+            THEN("Every key is found, and only those")
+            {
+                REQUIRE(flat.Size() == 5);
+                REQUIRE(flat.NodeCount() == 6);
+                REQUIRE(flat.Get({}) == 0);
+                REQUIRE(flat.Get({ 'a', 'c', 'd' }) == 3);
+                REQUIRE(flat.Get({ 'b' }) == 4);
+                REQUIRE(flat.Contains({ 'a', 'c' }) == false);
+                REQUIRE(flat.Contains({ 'c' }) == false);
+                REQUIRE(flat.Contains({ 'a', 'b', 'c' }) == false);
+            }
+            THEN("Keys are visited in the order of the Trie")
+            {
+                auto keys = std::vector<std::vector<char>>{};
+                auto expected = std::vector<std::vector<char>>{};
+                flat.ForEach([&keys](const auto& key, int) { keys.push_back(key); });
+                tree.ForEach([&expected](const auto& key, int) { expected.push_back(key); });
+                REQUIRE(keys == expected);
+            }
+        }
+    }
+
+    GIVEN("Sorted keys with a repeated one")
+    {
+        auto flat = FlatPrefixTree<int, int>{ { { { 1 }, 1 }, { { 1, 2 }, 2 }, { { 1, 2 }, 3 }, { { 2 }, 4 } } };
+        THEN("The last information of the repeated key is kept")
+        {
+            REQUIRE(flat.Size() == 3);
+            REQUIRE(flat.Get({ 1, 2 }) == 3);
+        }
+    }
+
+    GIVEN("No key")
+    {
+        auto flat = FlatPrefixTree<int, int>{};
+        THEN("It is empty")
+        {
+            REQUIRE(flat.Empty());
+            REQUIRE(flat.Contains({}) == false);
+            REQUIRE(flat.Contains({ 1 }) == false);
+        }
+    }
+}
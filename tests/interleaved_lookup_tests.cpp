@@ -0,0 +1,52 @@
+#include "catch.hpp"
+
+#include "../interleaved_lookup.hpp"
+
+SCENARIO("Many keys can be looked up with interleaved descents")
+{
+    GIVEN("A Trie, and keys present or not")
+    {
+        auto tree = PrefixTree<int, int>{};
+        auto keys = std::vector<std::vector<int>>{};
+        for (int i = 0; i < 100; ++i)
+        {
+            tree.Insert({ i % 10, i / 10, i }, i);
+            keys.push_back({ i % 10, i / 10, i });
+            keys.push_back({ i % 10, i });
+        }
+        keys.push_back({});
+        keys.push_back({ 3 });
+
+        WHEN("They are looked up in groups")
+        {
+            for (std::size_t group : { 1U, 3U, 8U, 1000U })
+            {
+                auto batched = tree.MultiGet(keys, group);
+                auto interleaved = InterleavedGet(tree, keys, group);
+                THEN("Every result is the one Get returns, in order")
+                {
+                    REQUIRE(batched.size() == keys.size());
+                    REQUIRE(interleaved.size() == keys.size());
+                    for (std::size_t i = 0; i < keys.size(); ++i)
+                    {
+                        REQUIRE(batched[i] == tree.Get(keys[i]));
+                        REQUIRE(interleaved[i] == tree.Get(keys[i]));
+                    }
+                }
+            }
+        }
+
+        WHEN("A lookup is stepped by hand")
+        {
+            auto lookup = tree.MakeLookup(keys[0]);
+            std::size_t steps = 1;
+            while (!lookup.Step())
+                ++steps;
+            THEN("It follows one edge per step")
+            {
+                REQUIRE(steps == keys[0].size());
+                REQUIRE(lookup.Result() == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "../lazy_prefix_tree.hpp"
+
+SCENARIO("Subtrees can be loaded on demand from a file, within a residency budget")
+{
+    GIVEN("A Trie written to a file, cut at depth 1")
+    {
+        auto tree = PrefixTree<int, int>{};
+        for (int i = 0; i < 1000; ++i)
+            tree.Insert({ i % 10, i }, i);
+        tree.Insert({}, -1);
+        const auto path = (std::filesystem::temp_directory_path() / "lazy_prefix_tree_tests.bin").string();
+        {
+            auto out = std::ofstream{ path, std::ios::binary };
+            LazyPrefixTree<int, int>::Write(out, tree, 1);
+        }
+
+        WHEN("It is opened with room for about two subtrees")
+        {
+            // Each subtree holds 100 keys, of a few bytes each
+            auto lazy = LazyPrefixTree<int, int>{ path, 2000 };
+            THEN("Nothing is loaded until a subtree is read")
+            {
+                REQUIRE(lazy.Size() == 1001);
+                REQUIRE(lazy.SubtreeCount() == 10);
+                REQUIRE(lazy.Get({}) == -1);
+                REQUIRE(lazy.ResidentCount() == 0);
+            }
+            THEN("Every key is found, and cold subtrees are evicted")
+            {
+                for (int i = 0; i < 1000; ++i)
+                    REQUIRE(lazy.Get({ i % 10, i }) == i);
+                REQUIRE(lazy.Contains({ 3, 4 }) == false);
+                REQUIRE(lazy.Contains({ 12, 12 }) == false);
+                REQUIRE(lazy.ResidentCount() < 10);
+                REQUIRE(lazy.ResidentBytes() <= 2000);
+            }
+            THEN("A subtree read again stays loaded")
+            {
+                for (int round = 0; round < 3; ++round)
+                {
+                    for (int i = 0; i < 10; ++i)
+                        REQUIRE(lazy.Get({ i, i }) == i);
+                    REQUIRE(lazy.Get({ 0, 10 }) == 10);
+                }
+                REQUIRE(lazy.ResidentCount() >= 1);
+            }
+        }
+
+        WHEN("It is opened with no budget")
+        {
+            auto lazy = LazyPrefixTree<int, int>{ path, 0 };
+            THEN("Only the subtree in use is kept")
+            {
+                REQUIRE(lazy.Get({ 4, 994 }) == 994);
+                REQUIRE(lazy.Get({ 5, 995 }) == 995);
+                REQUIRE(lazy.ResidentCount() == 1);
+            }
+        }
+
+        WHEN("The file is not a lazy Trie")
+        {
+            {
+                auto out = std::ofstream{ path, std::ios::binary };
+                out << "not a trie, but long enough to hold a trailer of the right size";
+            }
+            THEN("Opening it throws")
+            {
+                REQUIRE_THROWS(LazyPrefixTree<int, int>{ path, 0 });
+            }
+        }
+        std::remove(path.c_str());
+    }
+}
@@ -0,0 +1,69 @@
+#include "catch.hpp"
+
+#include "../leapfrog_triejoin.hpp"
+
+SCENARIO("Relations stored in Tries can be joined with Leapfrog Triejoin")
+{
+    GIVEN("A graph stored as three edge relations")
+    {
+        const auto edges = std::vector<std::pair<int, int>>{ { 1, 2 }, { 1, 3 }, { 2, 3 }, { 2, 4 },
+                                                             { 3, 4 }, { 1, 4 }, { 4, 5 } };
+        auto r = PrefixTree<int, int>{};
+        auto s = PrefixTree<int, int>{};
+        auto t = PrefixTree<int, int>{};
+        for (const auto& [from, to] : edges)
+        {
+            r.Insert({ from, to }, from * 10 + to);
+            s.Insert({ from, to }, from * 10 + to);
+            t.Insert({ from, to }, from * 10 + to);
+        }
+
+        WHEN("We count triangles R(a, b), S(b, c), T(a, c)")
+        {
+            auto join = LeapfrogTriejoin<int, int>{};
+            join.AddRelation(r, { 0, 1 });
+            join.AddRelation(s, { 1, 2 });
+            join.AddRelation(t, { 0, 2 });
+
+            auto triangles = std::vector<std::vector<int>>{};
+            auto rows = std::vector<int>{};
+            join.Run([&](const std::vector<int>& binding, const std::vector<const int*>& infos) {
+                triangles.push_back(binding);
+                for (auto info : infos)
+                    rows.push_back(*info);
+            });
+
+            THEN("Every triangle is found once, in order, with the matching rows")
+            {
+                REQUIRE(triangles == std::vector<std::vector<int>>{ { 1, 2, 3 }, { 1, 2, 4 }, { 1, 3, 4 }, { 2, 3, 4 } });
+                REQUIRE(std::vector<int>(rows.begin(), rows.begin() + 3) == std::vector<int>{ 12, 23, 13 });
+            }
+        }
+
+        WHEN("An edge is erased from one relation")
+        {
+            s.Erase({ 3, 4 });
+            auto join = LeapfrogTriejoin<int, int>{};
+            join.AddRelation(r, { 0, 1 });
+            join.AddRelation(s, { 1, 2 });
+            join.AddRelation(t, { 0, 2 });
+
+            std::size_t count = 0;
+            join.Run([&count](const auto&, const auto&) { ++count; });
+            THEN("Triangles using it are gone")
+            {
+                REQUIRE(count == 2);
+            }
+        }
+    }
+
+    GIVEN("Relations with an invalid variable order")
+    {
+        auto r = PrefixTree<int, int>{};
+        auto join = LeapfrogTriejoin<int, int>{};
+        THEN("Adding them throws")
+        {
+            REQUIRE_THROWS(join.AddRelation(r, { 1, 0 }));
+        }
+    }
+}
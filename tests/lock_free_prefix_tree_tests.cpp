@@ -0,0 +1,83 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include "../lock_free_prefix_tree.hpp"
+
+SCENARIO("A Trie with lock-free readers can be read while it is written")
+{
+    GIVEN("An empty lock-free Trie")
+    {
+        auto tree = LockFreePrefixTree<int, int>{};
+
+        WHEN("We use it from a single thread")
+        {
+            tree.Insert({ 1, 2, 3 }, 10);
+            tree.Insert({ 1, 2 }, 20);
+            tree.Insert({ 1, 2, 3 }, 30);
+            THEN("It behaves like a PrefixTree")
+            {
+                REQUIRE(tree.Size() == 2);
+                REQUIRE(tree.Get({ 1, 2, 3 }) == 30);
+                REQUIRE(tree.Contains({ 1 }) == false);
+                auto seen = 0;
+                REQUIRE(tree.Visit({ 1, 2 }, [&seen](int info) { seen = info; }));
+                REQUIRE(seen == 20);
+            }
+            THEN("Erasing prunes empty branches and keeps the others")
+            {
+                tree.Insert({ 4, 5, 6 }, 40);
+                tree.Erase({ 4, 5, 6 });
+                tree.Erase({ 1, 2, 3 });
+                REQUIRE(tree.Contains({ 1, 2, 3 }) == false);
+                REQUIRE(tree.Get({ 1, 2 }) == 20);
+                REQUIRE_THROWS(tree.Erase({ 4, 5, 6 }));
+                REQUIRE_THROWS(tree.Erase({ 1 }));
+                REQUIRE(tree.Size() == 1);
+                tree.Insert({ 4, 5 }, 50);
+                REQUIRE(tree.Get({ 4, 5 }) == 50);
+            }
+        }
+
+        WHEN("Readers run while a writer inserts and erases")
+        {
+            constexpr int kKeys = 2000;
+            for (int i = 0; i < kKeys; i += 2)
+                tree.Insert({ i % 13, i }, i);
+
+            auto stop = std::atomic<bool>{ false };
+            auto wrong = std::atomic<int>{ 0 };
+            auto readers = std::vector<std::thread>{};
+            for (int id = 0; id < 3; ++id)
+            {
+                readers.emplace_back([&] {
+                    while (!stop.load())
+                    {
+                        for (int i = 0; i < kKeys; i += 2)
+                        {
+                            if (tree.Get({ i % 13, i }) != i)
+                                ++wrong;
+                        }
+                    }
+                });
+            }
+            for (int round = 0; round < 5; ++round)
+            {
+                for (int i = 1; i < kKeys; i += 2)
+                    tree.Insert({ i % 13, i }, i);
+                for (int i = 1; i < kKeys; i += 2)
+                    tree.Erase({ i % 13, i });
+            }
+            stop = true;
+            for (auto& reader : readers)
+                reader.join();
+
+            THEN("Readers always see the keys that were never touched")
+            {
+                REQUIRE(wrong == 0);
+                REQUIRE(tree.Size() == kKeys / 2);
+            }
+        }
+    }
+}
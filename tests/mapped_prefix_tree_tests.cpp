@@ -0,0 +1,65 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "../mapped_prefix_tree.hpp"
+
+SCENARIO("A Trie can be written to a file and queried in place")
+{
+    GIVEN("A Trie written to a file")
+    {
+        auto tree = PrefixTree<char, double>{};
+        tree.Insert({ 'a' }, 1.0);
+        tree.Insert({ 'a', 'b', 'c' }, 3.0);
+        tree.Insert({ 'a', 'b', 'd' }, 4.0);
+        tree.Insert({ 'b' }, 2.0);
+        const auto path = (std::filesystem::temp_directory_path() / "mapped_prefix_tree_tests.bin").string();
+        {
+            auto out = std::ofstream{ path, std::ios::binary };
+            MappedPrefixTree<char, double>::Write(out, tree);
+        }
+
+        WHEN("The file is mapped")
+        {
+            auto mapped = MappedPrefixTree<char, double>{ path };
+            THEN("Keys are found in place")
+            {
+                REQUIRE(mapped.Size() == 4);
+                REQUIRE(mapped.Get({ 'a', 'b', 'd' }) == 4.0);
+                REQUIRE(mapped.Contains({ 'a', 'b' }) == false);
+                REQUIRE(mapped.Contains({ 'c' }) == false);
+            }
+            THEN("Keys with a prefix are visited in order")
+            {
+                auto keys = std::vector<std::vector<char>>{};
+                mapped.ForEachWithPrefix({ 'a', 'b' }, [&keys](const auto& key, double) { keys.push_back(key); });
+                REQUIRE(keys == std::vector<std::vector<char>>{ { 'a', 'b', 'c' }, { 'a', 'b', 'd' } });
+                mapped.ForEachWithPrefix({ 'z' }, [&keys](const auto& key, double) { keys.push_back(key); });
+                REQUIRE(keys.size() == 2);
+            }
+            THEN("The longest present prefix of a key is found")
+            {
+                REQUIRE(mapped.LongestPrefixMatch({ 'a', 'b', 'c', 'e' }) == std::size_t{ 3 });
+                REQUIRE(mapped.LongestPrefixMatch({ 'a', 'b', 'e' }) == std::size_t{ 1 });
+                REQUIRE(mapped.LongestPrefixMatch({ 'c' }).has_value() == false);
+            }
+            THEN("The mapping can be moved")
+            {
+                auto moved = std::move(mapped);
+                REQUIRE(moved.Get({ 'b' }) == 2.0);
+            }
+        }
+
+        WHEN("The file does not hold a Trie of this type")
+        {
+            THEN("Mapping it throws")
+            {
+                REQUIRE_THROWS(MappedPrefixTree<char, int>{ path });
+                REQUIRE_THROWS(MappedPrefixTree<char, double>{ path + ".missing" });
+            }
+        }
+        std::remove(path.c_str());
+    }
+}
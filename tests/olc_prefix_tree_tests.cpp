@@ -0,0 +1,88 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include "../olc_prefix_tree.hpp"
+
+SCENARIO("A Trie with optimistic lock coupling supports concurrent writers")
+{
+    GIVEN("An empty optimistic Trie")
+    {
+        auto tree = OlcPrefixTree<int, int>{};
+
+        WHEN("We use it from a single thread")
+        {
+            for (int i = 9; i >= 0; --i)
+                tree.Insert({ 1, i }, i);
+            tree.Insert({ 1 }, 100);
+            tree.Insert({ 1, 5 }, 50);
+            THEN("It behaves like a PrefixTree, even after edge arrays grow")
+            {
+                REQUIRE(tree.Size() == 11);
+                REQUIRE(tree.Get({ 1, 0 }) == 0);
+                REQUIRE(tree.Get({ 1, 5 }) == 50);
+                REQUIRE(tree.Get({ 1, 9 }) == 9);
+                REQUIRE(tree.Get({ 1 }) == 100);
+                REQUIRE(tree.Contains({ 1, 10 }) == false);
+            }
+            THEN("Erased keys are gone, and their leaves unlinked")
+            {
+                tree.Erase({ 1, 3 });
+                tree.Erase({ 1 });
+                REQUIRE(tree.Contains({ 1, 3 }) == false);
+                REQUIRE(tree.Contains({ 1 }) == false);
+                REQUIRE(tree.Get({ 1, 4 }) == 4);
+                REQUIRE_THROWS(tree.Erase({ 1, 3 }));
+                REQUIRE(tree.Size() == 9);
+                tree.Insert({ 1, 3, 7 }, 37);
+                REQUIRE(tree.Get({ 1, 3, 7 }) == 37);
+            }
+        }
+
+        WHEN("Several writers insert while readers look up")
+        {
+            constexpr int kWriters = 4;
+            constexpr int kKeys = 400;
+            auto stop = std::atomic<bool>{ false };
+            auto wrong = std::atomic<int>{ 0 };
+            auto reader = std::thread{ [&] {
+                while (!stop.load())
+                {
+                    for (int i = 0; i < kKeys; ++i)
+                    {
+                        auto info = tree.Get({ i % 7, 0, i });
+                        if (info && info != i)
+                            ++wrong;
+                    }
+                }
+            } };
+
+            auto writers = std::vector<std::thread>{};
+            for (int id = 0; id < kWriters; ++id)
+            {
+                writers.emplace_back([&tree, id] {
+                    for (int i = 0; i < kKeys; ++i)
+                        tree.Insert({ i % 7, id, i }, i);
+                    for (int i = 0; i < kKeys; i += 2)
+                        tree.Erase({ i % 7, id, i });
+                });
+            }
+            for (auto& writer : writers)
+                writer.join();
+            stop = true;
+            reader.join();
+
+            THEN("Every write is applied exactly once")
+            {
+                REQUIRE(wrong == 0);
+                REQUIRE(tree.Size() == kWriters * kKeys / 2);
+                for (int id = 0; id < kWriters; ++id)
+                {
+                    REQUIRE(tree.Get({ 1 % 7, id, 1 }) == 1);
+                    REQUIRE(tree.Contains({ 2 % 7, id, 2 }) == false);
+                }
+            }
+        }
+    }
+}
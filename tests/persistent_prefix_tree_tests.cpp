@@ -0,0 +1,54 @@
+#include "catch.hpp"
+
+#include "../persistent_prefix_tree.hpp"
+
+SCENARIO("A persistent Trie keeps every version")
+{
+    GIVEN("A few versions of a persistent Trie")
+    {
+        const auto empty = PersistentPrefixTree<int, int>{};
+        const auto first = empty.Insert({ 1, 2, 3 }, 10).Insert({ 1, 2 }, 20).Insert({ 4 }, 40);
+        const auto second = first.Insert({ 1, 2, 3 }, 30).Insert({ 1, 5 }, 50);
+        const auto third = second.Erase({ 1, 2, 3 }).Erase({ 4 });
+
+        THEN("Each version only sees its own writes")
+        {
+            REQUIRE(empty.Empty());
+            REQUIRE(empty.Contains({ 1, 2, 3 }) == false);
+
+            REQUIRE(first.Size() == 3);
+            REQUIRE(first.Get({ 1, 2, 3 }) == 10);
+            REQUIRE(first.Contains({ 1, 5 }) == false);
+
+            REQUIRE(second.Size() == 4);
+            REQUIRE(second.Get({ 1, 2, 3 }) == 30);
+            REQUIRE(second.Get({ 1, 5 }) == 50);
+            REQUIRE(second.Get({ 4 }) == 40);
+
+            REQUIRE(third.Size() == 2);
+            REQUIRE(third.Contains({ 1, 2, 3 }) == false);
+            REQUIRE(third.Contains({ 4 }) == false);
+            REQUIRE(third.Get({ 1, 2 }) == 20);
+        }
+
+        THEN("Erasing a missing key throws, and leaves the version as it was")
+        {
+            REQUIRE_THROWS(third.Erase({ 4 }));
+            REQUIRE_THROWS(third.Erase({ 1 }));
+            REQUIRE(third.Size() == 2);
+        }
+
+        THEN("Versions iterate their keys in order, without pruned branches")
+        {
+            auto keys = std::vector<std::vector<int>>{};
+            third.ForEach([&keys](const std::vector<int>& key, int) { keys.push_back(key); });
+            REQUIRE(keys == std::vector<std::vector<int>>{ { 1, 2 }, { 1, 5 } });
+
+            auto emptied = third.Erase({ 1, 2 }).Erase({ 1, 5 });
+            auto count = 0;
+            emptied.ForEach([&count](const std::vector<int>&, int) { ++count; });
+            REQUIRE(count == 0);
+            REQUIRE(emptied.Empty());
+        }
+    }
+}
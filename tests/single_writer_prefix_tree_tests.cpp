@@ -0,0 +1,98 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include "../single_writer_prefix_tree.hpp"
+
+SCENARIO("A single-writer Trie publishes batches atomically")
+{
+    GIVEN("A single-writer Trie")
+    {
+        auto tree = SingleWriterPrefixTree<int, int>{};
+
+        WHEN("The writer applies a batch")
+        {
+            tree.Insert({ 1, 2, 3 }, 10);
+            tree.Insert({ 1, 2 }, 20);
+            THEN("Readers only see it once it is published")
+            {
+                REQUIRE(tree.Empty());
+                REQUIRE(tree.Contains({ 1, 2, 3 }) == false);
+                tree.Publish();
+                REQUIRE(tree.Size() == 2);
+                REQUIRE(tree.Get({ 1, 2, 3 }) == 10);
+            }
+            THEN("Later batches leave the versions readers hold untouched")
+            {
+                tree.Publish();
+                tree.Read([&tree](const auto& view) {
+                    tree.Insert({ 1, 2, 3 }, 30);
+                    tree.Erase({ 1, 2 });
+                    tree.Insert({ 4 }, 40);
+                    tree.Publish();
+                    REQUIRE(view.Size() == 2);
+                    REQUIRE(view.Get({ 1, 2, 3 }) == 10);
+                    REQUIRE(view.Get({ 1, 2 }) == 20);
+                    REQUIRE(view.Contains({ 4 }) == false);
+                });
+                REQUIRE(tree.Get({ 1, 2, 3 }) == 30);
+                REQUIRE(tree.Contains({ 1, 2 }) == false);
+                REQUIRE(tree.Size() == 2);
+                REQUIRE_THROWS(tree.Erase({ 1, 2 }));
+            }
+        }
+
+        WHEN("Readers query while the writer publishes batches")
+        {
+            constexpr int kBatches = 200;
+            constexpr int kBatchSize = 10;
+            auto done = std::atomic<bool>{ false };
+            auto consistent = std::atomic<bool>{ true };
+            auto readers = std::vector<std::thread>{};
+            for (int id = 0; id < 3; ++id)
+            {
+                readers.emplace_back([&] {
+                    while (!done.load())
+                    {
+                        // Batch b inserts keys of b and erases those of b - 1, so a version holds a single batch
+                        tree.Read([&consistent](const auto& view) {
+                            auto first = -1;
+                            auto count = 0;
+                            view.ForEach([&](const std::vector<int>& key, int) {
+                                if (first < 0)
+                                    first = key.front();
+                                if (key.front() != first)
+                                    consistent = false;
+                                ++count;
+                            });
+                            if (count != 0 && count != kBatchSize)
+                                consistent = false;
+                        });
+                    }
+                });
+            }
+
+            for (int batch = 0; batch < kBatches; ++batch)
+            {
+                for (int i = 0; i < kBatchSize; ++i)
+                {
+                    tree.Insert({ batch, i }, i);
+                    if (batch > 0)
+                        tree.Erase({ batch - 1, i });
+                }
+                tree.Publish();
+            }
+            done = true;
+            for (auto& reader : readers)
+                reader.join();
+
+            THEN("Every reader saw whole batches")
+            {
+                REQUIRE(consistent);
+                REQUIRE(tree.Size() == kBatchSize);
+                REQUIRE(tree.Get({ kBatches - 1, 3 }) == 3);
+            }
+        }
+    }
+}
@@ -1,5 +1,9 @@
 #include "catch.hpp"
 
+#include <atomic>
+#include <climits>
+#include <sstream>
+
 #include "../prefix_tree.hpp"
 
 // For generalization, we must now use a vector instead of a string
@@ -272,4 +276,625 @@ SCENARIO("Size gets updated when inserting into previously erased node")
             }
         }
     }
-}
\ No newline at end of file
+}
+SCENARIO("Keys can be queried with positional patterns")
+{
+    GIVEN("A Trie with fixed-structure keys")
+    {
+        using P = PatternElement<int>;
+        auto tree = PrefixTree<int, int>{};
+        tree.Insert({ 1, 10, 2024, 5 }, 0);
+        tree.Insert({ 1, 11, 2024, 6 }, 1);
+        tree.Insert({ 1, 12, 2023, 7 }, 2);
+        tree.Insert({ 2, 10, 2024, 5 }, 3);
+        tree.Insert({ 1, 10, 2024 }, 4);
+
+        auto matches = std::vector<int>{};
+        auto collect = [&matches](const std::vector<int>&, int info) { matches.push_back(info); };
+
+        WHEN("We match with wildcards")
+        {
+            tree.Match({ 1, P::Any(), 2024, P::Any() }, collect);
+            THEN("Only keys of the same length with equal concrete positions are visited, in order")
+            {
+                REQUIRE(matches == std::vector<int>{ 0, 1 });
+            }
+        }
+
+        WHEN("We match with a range")
+        {
+            tree.Match({ P::Any(), P::Range(11, 20), P::Any(), P::Any() }, collect);
+            THEN("Only edges inside the range are expanded")
+            {
+                REQUIRE(matches == std::vector<int>{ 1, 2 });
+            }
+        }
+
+        WHEN("We match with concrete values only")
+        {
+            tree.Match({ 2, 10, 2024, 5 }, collect);
+            THEN("It behaves as a lookup")
+            {
+                REQUIRE(matches == std::vector<int>{ 3 });
+            }
+        }
+
+        WHEN("We match against an erased key")
+        {
+            tree.Erase({ 1, 11, 2024, 6 });
+            tree.Match({ 1, P::Any(), 2024, P::Any() }, collect);
+            THEN("It is not reported")
+            {
+                REQUIRE(matches == std::vector<int>{ 0 });
+            }
+        }
+    }
+}
+
+SCENARIO("Best scored keys under a prefix can be queried")
+{
+    GIVEN("A Trie with a MaxScore Reducer")
+    {
+        struct ByFrequency
+        {
+            auto operator()(int frequency) const -> int { return frequency; }
+        };
+        auto tree = PrefixTree<char, int, MaxScore<ByFrequency>>{};
+        tree.Insert("app"_vc, 5);
+        tree.Insert("apple"_vc, 40);
+        tree.Insert("apply"_vc, 10);
+        tree.Insert("apricot"_vc, 30);
+        tree.Insert("banana"_vc, 100);
+
+        WHEN("We ask for the top keys of a prefix")
+        {
+            auto top = tree.TopK("ap"_vc, 3);
+            THEN("They come best first, restricted to the prefix")
+            {
+                REQUIRE(top.size() == 3);
+                REQUIRE(top[0] == std::make_pair("apple"_vc, 40));
+                REQUIRE(top[1] == std::make_pair("apricot"_vc, 30));
+                REQUIRE(top[2] == std::make_pair("apply"_vc, 10));
+            }
+        }
+
+        WHEN("We ask for more keys than there are")
+        {
+            THEN("Every key of the prefix is returned")
+            {
+                REQUIRE(tree.TopK("app"_vc, 10).size() == 3);
+                REQUIRE(tree.TopK("cherry"_vc, 10).empty());
+            }
+        }
+
+        WHEN("We erase and overwrite keys")
+        {
+            tree.Erase("apple"_vc);
+            tree.Insert("apply"_vc, 1);
+            auto top = tree.TopK("ap"_vc, 2);
+            THEN("The subtree maximums are kept up to date")
+            {
+                REQUIRE(top[0] == std::make_pair("apricot"_vc, 30));
+                REQUIRE(top[1] == std::make_pair("app"_vc, 5));
+                REQUIRE(tree.TopK({}, 1)[0].first == "banana"_vc);
+            }
+        }
+    }
+}
+
+SCENARIO("Information can be aggregated per prefix with a user-defined Reducer")
+{
+    GIVEN("A Trie summing its information")
+    {
+        struct Sum
+        {
+            auto Lift(int info) const -> long { return info; }
+            auto Combine(long lhs, long rhs) const -> long { return lhs + rhs; }
+        };
+        auto tree = PrefixTree<char, int, Sum>{};
+        tree.Insert("apple"_vc, 1);
+        tree.Insert("apply"_vc, 2);
+        tree.Insert("app"_vc, 4);
+        tree.Insert("banana"_vc, 8);
+
+        THEN("Every prefix knows the sum of its subtree")
+        {
+            REQUIRE(tree.Aggregate({}) == 15);
+            REQUIRE(tree.Aggregate("app"_vc) == 7);
+            REQUIRE(tree.Aggregate("appl"_vc) == 3);
+            REQUIRE(tree.Aggregate("cherry"_vc) == 0);
+        }
+
+        WHEN("We overwrite and erase keys")
+        {
+            tree.Insert("apple"_vc, 16);
+            tree.Erase("app"_vc);
+            THEN("The sums along their paths are updated")
+            {
+                REQUIRE(tree.Aggregate("app"_vc) == 18);
+                REQUIRE(tree.Aggregate({}) == 26);
+            }
+        }
+    }
+
+    GIVEN("A Trie with a custom minimum and maximum Reducer")
+    {
+        struct Range
+        {
+            int min;
+            int max;
+        };
+        struct MinMax
+        {
+            auto Identity() const -> Range { return { INT_MAX, INT_MIN }; }
+            auto Lift(int info) const -> Range { return { info, info }; }
+            auto Combine(const Range& lhs, const Range& rhs) const -> Range
+            {
+                return { std::min(lhs.min, rhs.min), std::max(lhs.max, rhs.max) };
+            }
+        };
+        auto tree = PrefixTree<int, int, MinMax>{};
+        tree.Insert({ 1, 1 }, 0);
+        tree.Insert({ 1, 2 }, -5);
+        tree.Insert({ 2, 1 }, 7);
+
+        THEN("Identity is used for empty subtrees, and min and max for the others")
+        {
+            REQUIRE(tree.Aggregate({ 1 }).min == -5);
+            REQUIRE(tree.Aggregate({ 1 }).max == 0);
+            REQUIRE(tree.Aggregate({ 3 }).min == INT_MAX);
+        }
+    }
+
+    GIVEN("A Trie with a non-commutative Reducer")
+    {
+        struct Concatenate
+        {
+            auto Lift(const std::string& info) const -> std::string { return info; }
+            auto Combine(const std::string& lhs, const std::string& rhs) const -> std::string { return lhs + rhs; }
+        };
+        auto tree = PrefixTree<char, std::string, Concatenate>{};
+        tree.Insert("b"_vc, "2");
+        tree.Insert("a"_vc, "1");
+        tree.Insert("ab"_vc, "3");
+
+        THEN("Information is combined in key order")
+        {
+            REQUIRE(tree.Aggregate({}) == "132");
+        }
+    }
+}
+
+SCENARIO("Tries can be merged")
+{
+    GIVEN("Two Tries with some keys in common")
+    {
+        struct Sum
+        {
+            auto Lift(int info) const -> int { return info; }
+            auto Combine(int lhs, int rhs) const -> int { return lhs + rhs; }
+        };
+        auto ours = PrefixTree<char, int, Sum>{};
+        ours.Insert("apple"_vc, 1);
+        ours.Insert("banana"_vc, 2);
+        auto theirs = PrefixTree<char, int, Sum>{};
+        theirs.Insert("apple"_vc, 10);
+        theirs.Insert("apricot"_vc, 20);
+        theirs.Insert("cherry"_vc, 40);
+
+        WHEN("We merge them with a resolver")
+        {
+            auto conflicts = std::vector<std::vector<char>>{};
+            ours.Merge(std::move(theirs), [&conflicts](const std::vector<char>& key, int mine, int other) {
+                conflicts.push_back(key);
+                return mine + other;
+            });
+            THEN("The resolver is only called on common keys")
+            {
+                REQUIRE(conflicts == std::vector<std::vector<char>>{ "apple"_vc });
+                REQUIRE(ours.Get("apple"_vc) == 11);
+            }
+            THEN("Keys of both Tries are present, and counted once")
+            {
+                REQUIRE(ours.Size() == 4);
+                REQUIRE(ours.Get("apricot"_vc) == 20);
+                REQUIRE(ours.Get("cherry"_vc) == 40);
+                REQUIRE(ours.Aggregate("ap"_vc) == 31);
+                REQUIRE(ours.Aggregate({}) == 73);
+            }
+            THEN("The other Trie is left empty")
+            {
+                REQUIRE(theirs.Empty());
+                REQUIRE(theirs.Contains("cherry"_vc) == false);
+            }
+        }
+
+        WHEN("We merge them without a resolver")
+        {
+            ours.Merge(std::move(theirs));
+            THEN("Their information wins, as with Insert")
+            {
+                REQUIRE(ours.Get("apple"_vc) == 10);
+                REQUIRE(ours.Get("banana"_vc) == 2);
+            }
+        }
+
+        WHEN("We merge them with a third Trie in parallel")
+        {
+            auto third = PrefixTree<char, int, Sum>{};
+            third.Insert("apple"_vc, 100);
+            third.Insert("band"_vc, 200);
+            third.Insert(""_vc, 400);
+            auto trees = std::vector<PrefixTree<char, int, Sum>>{};
+            trees.push_back(std::move(ours));
+            trees.push_back(std::move(theirs));
+            trees.push_back(std::move(third));
+            auto merged = PrefixTree<char, int, Sum>::ParallelMerge(
+                std::move(trees), [](const std::vector<char>&, int mine, int other) { return mine + other; }, 4);
+            THEN("The result is the same as merging them one after the other")
+            {
+                REQUIRE(merged.Size() == 6);
+                REQUIRE(merged.Get("apple"_vc) == 111);
+                REQUIRE(merged.Get("band"_vc) == 200);
+                REQUIRE(merged.Get(""_vc) == 400);
+                REQUIRE(merged.Aggregate("ap"_vc) == 131);
+                REQUIRE(merged.Aggregate({}) == 773);
+            }
+        }
+    }
+}
+
+SCENARIO("Set operations can be computed between Tries")
+{
+    GIVEN("Two Tries with some keys in common")
+    {
+        auto ours = PrefixTree<char, int>{};
+        ours.Insert("apple"_vc, 1);
+        ours.Insert("apricot"_vc, 2);
+        ours.Insert("banana"_vc, 3);
+        ours.Insert("cherry"_vc, 4);
+        auto theirs = PrefixTree<char, int>{};
+        theirs.Insert("apple"_vc, 10);
+        theirs.Insert("apply"_vc, 20);
+        theirs.Insert("cherry"_vc, 40);
+        theirs.Insert("date"_vc, 50);
+
+        WHEN("We intersect them")
+        {
+            auto result = ours.Intersect(theirs);
+            THEN("Only common keys remain, with our information")
+            {
+                REQUIRE(result.Size() == 2);
+                REQUIRE(result.Get("apple"_vc) == 1);
+                REQUIRE(result.Get("cherry"_vc) == 4);
+                REQUIRE(result.Contains("apply"_vc) == false);
+            }
+        }
+
+        WHEN("We compute the difference")
+        {
+            auto result = ours.Difference(theirs);
+            THEN("Only our keys missing from theirs remain")
+            {
+                REQUIRE(result.Size() == 2);
+                REQUIRE(result.Get("apricot"_vc) == 2);
+                REQUIRE(result.Get("banana"_vc) == 3);
+            }
+        }
+
+        WHEN("We compute the symmetric difference")
+        {
+            auto result = ours.SymmetricDifference(theirs);
+            THEN("Keys present on a single side remain, with their information")
+            {
+                REQUIRE(result.Size() == 4);
+                REQUIRE(result.Get("apricot"_vc) == 2);
+                REQUIRE(result.Get("apply"_vc) == 20);
+                REQUIRE(result.Get("date"_vc) == 50);
+                REQUIRE(result.Contains("apple"_vc) == false);
+            }
+        }
+
+        WHEN("We stream the operations instead")
+        {
+            auto keys = std::vector<std::vector<char>>{};
+            auto common = 0;
+            ours.ForEachIntersection(theirs, [&](const std::vector<char>& key, int mine, int other) {
+                keys.push_back(key);
+                common += mine + other;
+            });
+            THEN("Common keys are visited in order with both informations")
+            {
+                REQUIRE(keys == std::vector<std::vector<char>>{ "apple"_vc, "cherry"_vc });
+                REQUIRE(common == 55);
+            }
+
+            keys.clear();
+            auto collect = [&keys](const std::vector<char>& key, int) { keys.push_back(key); };
+            ours.ForEachDifference(theirs, collect);
+            THEN("Difference keys are visited in order")
+            {
+                REQUIRE(keys == std::vector<std::vector<char>>{ "apricot"_vc, "banana"_vc });
+            }
+
+            keys.clear();
+            ours.ForEachSymmetricDifference(theirs, collect);
+            THEN("Symmetric difference keys from both sides are visited in order")
+            {
+                REQUIRE(keys == std::vector<std::vector<char>>{ "apply"_vc, "apricot"_vc, "banana"_vc, "date"_vc });
+            }
+        }
+
+        WHEN("A key was erased from one side")
+        {
+            ours.Erase("banana"_vc);
+            auto result = ours.Difference(theirs);
+            THEN("Its empty branch is not carried over")
+            {
+                REQUIRE(result.Size() == 1);
+                REQUIRE(result.Contains("banana"_vc) == false);
+            }
+        }
+    }
+}
+
+SCENARIO("Keys can be grouped by prefix and aggregated")
+{
+    GIVEN("A Trie of sales keyed by region, store and day")
+    {
+        auto tree = PrefixTree<int, int>{};
+        tree.Insert({ 1, 1, 1 }, 10);
+        tree.Insert({ 1, 1, 2 }, 20);
+        tree.Insert({ 1, 2, 1 }, 30);
+        tree.Insert({ 2, 1, 1 }, 40);
+        tree.Insert({ 3 }, 50);
+        tree.Insert({ 4, 1, 1 }, 60);
+        tree.Erase({ 4, 1, 1 });
+
+        using Group = std::pair<std::vector<int>, int>;
+        auto groups = std::vector<Group>{};
+        auto sum = [](int total, int sales) { return total + sales; };
+        auto collect = [&groups](const std::vector<int>& group, int total) { groups.emplace_back(group, total); };
+
+        WHEN("We group by region")
+        {
+            tree.GroupBy(1, 0, sum, collect);
+            THEN("Every region with keys is folded once, in order")
+            {
+                REQUIRE(groups == std::vector<Group>{ { { 1 }, 60 }, { { 2 }, 40 }, { { 3 }, 50 } });
+            }
+        }
+
+        WHEN("We group by region and store")
+        {
+            tree.GroupBy(2, 0, sum, collect);
+            THEN("Keys shorter than the grouping depth are left out")
+            {
+                REQUIRE(groups == std::vector<Group>{ { { 1, 1 }, 30 }, { { 1, 2 }, 30 }, { { 2, 1 }, 40 } });
+            }
+        }
+
+        WHEN("We group in parallel")
+        {
+            tree.ParallelGroupBy(2, 0, sum, collect, 4);
+            THEN("The result is the same as the sequential one")
+            {
+                REQUIRE(groups == std::vector<Group>{ { { 1, 1 }, 30 }, { { 1, 2 }, 30 }, { { 2, 1 }, 40 } });
+            }
+        }
+    }
+}
+
+SCENARIO("Tries can be built in parallel")
+{
+    GIVEN("Keys spread over several first edges, some repeated")
+    {
+        auto keys = std::vector<std::vector<char>>{ "banana"_vc, "apple"_vc, "app"_vc, ""_vc,     "cherry"_vc,
+                                                    "apple"_vc,  "band"_vc,  "b"_vc,   "apply"_vc };
+        auto values = std::vector<int>{ 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+
+        WHEN("We build them on several workers")
+        {
+            struct Sum
+            {
+                auto Lift(int info) const -> long { return info; }
+                auto Combine(long lhs, long rhs) const -> long { return lhs + rhs; }
+            };
+            auto tree = PrefixTree<char, int, Sum>::ParallelBuild(keys, values, 4);
+            THEN("The Trie is the same as if the keys were inserted in order")
+            {
+                auto expected = PrefixTree<char, int, Sum>{};
+                for (std::size_t i = 0; i < keys.size(); ++i)
+                    expected.Insert(keys[i], values[i]);
+
+                REQUIRE(tree.Size() == expected.Size());
+                REQUIRE(tree.Size() == 8);
+                REQUIRE(tree.Get("apple"_vc) == 32);
+                REQUIRE(tree.Get(""_vc) == 8);
+                REQUIRE(tree.Contains("ban"_vc) == false);
+                REQUIRE(tree.Aggregate({}) == expected.Aggregate({}));
+                REQUIRE(tree.Aggregate("ap"_vc) == 292);
+                REQUIRE(tree.Aggregate("b"_vc) == 193);
+            }
+        }
+
+        WHEN("The number of values does not match")
+        {
+            values.pop_back();
+            THEN("The build is refused")
+            {
+                REQUIRE_THROWS_AS((PrefixTree<char, int>::ParallelBuild(keys, values, 2)), std::invalid_argument);
+            }
+        }
+    }
+}
+
+SCENARIO("Every key can be visited and reduced in parallel")
+{
+    GIVEN("A Trie with a skewed fan-out and erased keys")
+    {
+        auto tree = PrefixTree<int, int>{};
+        auto expected_sum = 0L;
+        for (int i = 0; i < 3000; ++i)
+        {
+            tree.Insert({ 0, i / 100, i % 100 }, i);
+            expected_sum += i;
+        }
+        for (int i = 1; i < 20; ++i)
+        {
+            tree.Insert({ i }, i);
+            expected_sum += i;
+        }
+        tree.Insert({}, 7);
+        tree.Erase({ 0, 5, 5 });
+        expected_sum += 7 - 505;
+
+        WHEN("We visit every key on several workers")
+        {
+            auto visited = std::atomic<long>{ 0 };
+            auto count = std::atomic<std::size_t>{ 0 };
+            tree.ParallelForEach(
+                [&](const std::vector<int>& key, int info) {
+                    if (key.size() != 3 || key[1] * 100 + key[2] == info)
+                        visited += info;
+                    ++count;
+                },
+                4);
+            THEN("Each key is visited exactly once, with its own key")
+            {
+                REQUIRE(count == tree.Size());
+                REQUIRE(visited == expected_sum);
+            }
+        }
+
+        WHEN("We reduce with an associative, non-commutative operation")
+        {
+            auto concatenate = [](std::vector<int> lhs, const std::vector<int>& rhs) {
+                lhs.insert(lhs.end(), rhs.begin(), rhs.end());
+                return lhs;
+            };
+            auto single = [](const std::vector<int>&, int info) { return std::vector<int>{ info }; };
+            const auto one = tree.ParallelReduce(std::vector<int>{}, single, concatenate, 1);
+            const auto many = tree.ParallelReduce(std::vector<int>{}, single, concatenate, 8);
+            THEN("The result is the sequential fold in key order, whatever the number of workers")
+            {
+                auto sequential = std::vector<int>{};
+                tree.GroupBy(0, 0, [&sequential](int, int info) { sequential.push_back(info); return 0; },
+                             [](const std::vector<int>&, int) {});
+                REQUIRE(one.size() == tree.Size());
+                REQUIRE(one == sequential);
+                REQUIRE(many == sequential);
+            }
+        }
+    }
+}
+
+SCENARIO("Nodes left behind by erases can be compacted away")
+{
+    GIVEN("A Trie with erased keys")
+    {
+        struct Sum
+        {
+            auto Lift(int info) const -> long { return info; }
+            auto Combine(long lhs, long rhs) const -> long { return lhs + rhs; }
+        };
+        auto tree = PrefixTree<int, int, Sum>{};
+        tree.Insert({ 1, 2, 3 }, 1);
+        tree.Insert({ 1, 2, 4 }, 2);
+        tree.Insert({ 5, 6 }, 3);
+        tree.Erase({ 1, 2, 4 });
+        tree.Erase({ 5, 6 });
+
+        WHEN("It is compacted")
+        {
+            auto compacted = tree.Compacted();
+            THEN("Only the nodes leading to keys are kept")
+            {
+                REQUIRE(tree.NodeCount() == 7);
+                REQUIRE(compacted.NodeCount() == 4);
+                REQUIRE(compacted.Size() == 1);
+                REQUIRE(compacted.Get({ 1, 2, 3 }) == 1);
+                REQUIRE(compacted.Aggregate({ 1 }) == 1);
+                REQUIRE(tree.Get({ 1, 2, 3 }) == 1);
+            }
+        }
+    }
+}
+
+SCENARIO("Tries can be written to a stream and read back")
+{
+    GIVEN("A Trie with aggregates and erased keys")
+    {
+        struct Sum
+        {
+            auto Lift(int info) const -> long { return info; }
+            auto Combine(long lhs, long rhs) const -> long { return lhs + rhs; }
+        };
+        auto tree = PrefixTree<int, int, Sum>{};
+        for (int i = 0; i < 300; ++i)
+            tree.Insert({ i % 3, i % 7, i }, i);
+        tree.Insert({}, 1000);
+        tree.Erase({ 2, 6, 146 });
+
+        WHEN("It is serialized and deserialized")
+        {
+            auto stream = std::stringstream{};
+            tree.Serialize(stream);
+            auto loaded = PrefixTree<int, int, Sum>::Deserialize(stream);
+            THEN("Keys, information and aggregates are the same, without the erased nodes")
+            {
+                REQUIRE(loaded.Size() == tree.Size());
+                REQUIRE(loaded.NodeCount() == tree.Compacted().NodeCount());
+                REQUIRE(loaded.Get({}) == 1000);
+                REQUIRE(loaded.Get({ 1, 3, 94 }) == 94);
+                REQUIRE(loaded.Contains({ 2, 6, 146 }) == false);
+                REQUIRE(loaded.Aggregate({}) == tree.Aggregate({}));
+                REQUIRE(loaded.Aggregate({ 2 }) == tree.Aggregate({ 2 }));
+            }
+        }
+
+        WHEN("The stream is truncated or not a Trie")
+        {
+            auto stream = std::stringstream{};
+            tree.Serialize(stream);
+            auto bytes = stream.str();
+            auto truncated = std::stringstream{ bytes.substr(0, bytes.size() / 2) };
+            auto garbage = std::stringstream{ std::string(64, 'x') };
+            THEN("Reading it throws")
+            {
+                REQUIRE_THROWS(PrefixTree<int, int, Sum>::Deserialize(truncated));
+                REQUIRE_THROWS(PrefixTree<int, int, Sum>::Deserialize(garbage));
+            }
+        }
+    }
+
+    GIVEN("A Trie of strings, and a codec for them")
+    {
+        struct StringCodec
+        {
+            auto Write(std::ostream& out, const std::string& value) const -> void
+            {
+                TrivialCodec<std::size_t>{}.Write(out, value.size());
+                out.write(value.data(), static_cast<std::streamsize>(value.size()));
+            }
+            auto Read(std::istream& in) const -> std::string
+            {
+                auto value = std::string(TrivialCodec<std::size_t>{}.Read(in), '\0');
+                in.read(value.data(), static_cast<std::streamsize>(value.size()));
+                return value;
+            }
+        };
+        auto tree = PrefixTree<char, std::string>{};
+        tree.Insert({ 'a', 'b' }, "ab");
+        tree.Insert({ 'a', 'c' }, "");
+        THEN("It is read back with the same codec")
+        {
+            auto stream = std::stringstream{};
+            tree.Serialize(stream, StringCodec{});
+            auto loaded = PrefixTree<char, std::string>::Deserialize(stream, StringCodec{});
+            REQUIRE(loaded.Size() == 2);
+            REQUIRE(loaded.Get({ 'a', 'b' }) == std::string{ "ab" });
+            REQUIRE(loaded.Get({ 'a', 'c' }) == std::string{});
+        }
+    }
+}
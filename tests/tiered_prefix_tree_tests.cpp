@@ -0,0 +1,85 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include "../tiered_prefix_tree.hpp"
+
+SCENARIO("Writes go to a delta over a frozen base, and are compacted into a new base")
+{
+    GIVEN("A tiered Trie over a base")
+    {
+        auto tree = TieredPrefixTree<int, int>{ FlatPrefixTree<int, int>{ { { { 1 }, 1 }, { { 1, 2 }, 2 } } } };
+
+        WHEN("Keys are inserted, overwritten and erased")
+        {
+            tree.Insert({ 3 }, 3);
+            tree.Insert({ 1 }, 10);
+            tree.Erase({ 1, 2 });
+            THEN("The delta hides the base")
+            {
+                REQUIRE(tree.Get({ 1 }) == 10);
+                REQUIRE(tree.Get({ 3 }) == 3);
+                REQUIRE(tree.Contains({ 1, 2 }) == false);
+                REQUIRE(tree.Size() == 2);
+                REQUIRE(tree.DeltaSize() == 3);
+                REQUIRE_THROWS(tree.Erase({ 1, 2 }));
+            }
+            THEN("Compaction folds the delta into the base")
+            {
+                tree.Compact();
+                REQUIRE(tree.DeltaSize() == 0);
+                REQUIRE(tree.Get({ 1 }) == 10);
+                REQUIRE(tree.Get({ 3 }) == 3);
+                REQUIRE(tree.Contains({ 1, 2 }) == false);
+                REQUIRE(tree.Size() == 2);
+            }
+            THEN("An erased key can be inserted again")
+            {
+                tree.Insert({ 1, 2 }, 20);
+                REQUIRE(tree.Get({ 1, 2 }) == 20);
+                REQUIRE(tree.Size() == 3);
+            }
+        }
+    }
+
+    GIVEN("A tiered Trie compacting in the background")
+    {
+        auto tree = TieredPrefixTree<int, int>{ {}, 64 };
+
+        WHEN("A writer inserts and erases while a reader reads")
+        {
+            constexpr int kKeys = 2000;
+            std::atomic<bool> done{ false };
+            std::atomic<bool> consistent{ true };
+            auto reader = std::thread{ [&] {
+                while (!done)
+                {
+                    // Key 0 is never erased once inserted
+                    auto info = tree.Get({ 0 });
+                    if (info && info != 0)
+                        consistent = false;
+                }
+            } };
+            for (int i = 0; i < kKeys; ++i)
+            {
+                tree.Insert({ i % 7, i }, i);
+                if (i == 0)
+                    tree.Insert({ 0 }, 0);
+                if (i % 2 == 1)
+                    tree.Erase({ i % 7, i });
+            }
+            done = true;
+            reader.join();
+            tree.Compact();
+
+            THEN("Readers always see a consistent Trie")
+            {
+                REQUIRE(consistent);
+                REQUIRE(tree.Size() == kKeys / 2 + 1);
+                REQUIRE(tree.Get({ 1998 % 7, 1998 }) == 1998);
+                REQUIRE(tree.Contains({ 1999 % 7, 1999 }) == false);
+            }
+        }
+    }
+}
@@ -0,0 +1,61 @@
+#include "catch.hpp"
+
+#include <string>
+#include <tuple>
+
+#include "../trie_join.hpp"
+
+SCENARIO("Two Tries can be joined on a shared key prefix")
+{
+    GIVEN("Orders and customers, both keyed by customer id first")
+    {
+        auto orders = PrefixTree<int, std::string>{};
+        orders.Insert({ 1, 100 }, "book");
+        orders.Insert({ 1, 101 }, "pen");
+        orders.Insert({ 3, 102 }, "lamp");
+        orders.Insert({ 4, 103 }, "desk");
+        auto customers = PrefixTree<int, int>{};
+        customers.Insert({ 1, 7 }, 1);
+        customers.Insert({ 2, 7 }, 2);
+        customers.Insert({ 3, 8 }, 3);
+        customers.Insert({ 3, 9 }, 4);
+
+        WHEN("We join them on the first edge")
+        {
+            using Pair = std::tuple<std::vector<int>, std::string, std::vector<int>, int>;
+            auto pairs = std::vector<Pair>{};
+            Join(orders, customers, 1,
+                 [&pairs](const std::vector<int>& order, const std::string& item, const std::vector<int>& customer,
+                          int id) { pairs.emplace_back(order, item, customer, id); });
+            THEN("The cross product of every matching group is emitted, in order")
+            {
+                REQUIRE(pairs == std::vector<Pair>{ { { 1, 100 }, "book", { 1, 7 }, 1 },
+                                                    { { 1, 101 }, "pen", { 1, 7 }, 1 },
+                                                    { { 3, 102 }, "lamp", { 3, 8 }, 3 },
+                                                    { { 3, 102 }, "lamp", { 3, 9 }, 4 } });
+            }
+        }
+
+        WHEN("We semi-join them on the first edge")
+        {
+            customers.Erase({ 1, 7 });
+            auto items = std::vector<std::string>{};
+            SemiJoin(orders, customers, 1,
+                     [&items](const std::vector<int>&, const std::string& item) { items.push_back(item); });
+            THEN("Only left keys with a live match on the right are emitted")
+            {
+                REQUIRE(items == std::vector<std::string>{ "lamp" });
+            }
+        }
+
+        WHEN("We join them on the whole key")
+        {
+            std::size_t count = 0;
+            Join(orders, customers, 2, [&count](const auto&, const auto&, const auto&, const auto&) { ++count; });
+            THEN("Nothing matches")
+            {
+                REQUIRE(count == 0);
+            }
+        }
+    }
+}
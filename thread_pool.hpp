@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Fixed-size, work-stealing pool of worker threads. \n
+ * \n
+ * Tasks are queued with `Submit` and run in no particular order. `Wait` blocks until every submitted task has
+ * finished, and rethrows the first exception thrown by a task, if any. \n
+ * Every worker owns a queue. Tasks submitted from outside are spread over the queues round-robin, and tasks
+ * submitted by a task go to the queue of its worker. A worker takes its newest task first, which is likely
+ * still in its cache, and once its queue is empty, steals the oldest task of another worker, so uneven tasks
+ * still keep every worker busy.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * Starts the workers.
+     * @param threads Number of workers. Zero means one per hardware thread.
+     */
+    explicit ThreadPool(std::size_t threads)
+    {
+        if (threads == 0)
+            threads = std::max(1U, std::thread::hardware_concurrency());
+        m_queue_count = threads;
+        m_queues = std::make_unique<Queue[]>(threads);
+        m_workers.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i)
+            m_workers.emplace_back([this, i] { Work_(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_stopping = true;
+        }
+        m_wake_workers.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    /**
+     * Queues a task to run on some worker. Tasks may submit more tasks.
+     */
+    auto Submit(std::function<void()> task) -> void
+    {
+        const auto index = t_pool == this ? t_worker : m_next_queue.fetch_add(1, std::memory_order_relaxed) % Size();
+        {
+            // Counted before being queued, so that a worker taking it never sees the counts go below zero
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            ++m_queued;
+            ++m_pending;
+        }
+        {
+            std::lock_guard<std::mutex> lock{ m_queues[index].m_mutex };
+            m_queues[index].m_tasks.push_back(std::move(task));
+        }
+        m_wake_workers.notify_one();
+    }
+
+    /**
+     * Blocks until every submitted task has finished. Rethrows the first exception thrown by a task.
+     */
+    auto Wait() -> void
+    {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        m_all_done.wait(lock, [this] { return m_pending == 0; });
+        if (m_error)
+            std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+
+    /**
+     * Returns the number of workers.
+     */
+    auto Size() const -> std::size_t { return m_queue_count; }
+
+private:
+    // Aligned so that neighbouring queues do not share a cache line
+    struct alignas(64) Queue
+    {
+        std::mutex m_mutex{};
+        std::deque<std::function<void()>> m_tasks{};
+    };
+
+    /**
+     * Takes the newest task of queue `index`, or else the oldest task of another queue. Returns false if every
+     * queue is empty.
+     */
+    auto Take_(std::size_t index, std::function<void()>& task) -> bool
+    {
+        for (std::size_t offset = 0; offset < Size(); ++offset)
+        {
+            auto& queue = m_queues[(index + offset) % Size()];
+            std::lock_guard<std::mutex> lock{ queue.m_mutex };
+            if (queue.m_tasks.empty())
+                continue;
+            if (offset == 0)
+            {
+                task = std::move(queue.m_tasks.back());
+                queue.m_tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(queue.m_tasks.front());
+                queue.m_tasks.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    auto Work_(std::size_t index) -> void
+    {
+        t_pool = this;
+        t_worker = index;
+        while (true)
+        {
+            std::function<void()> task;
+            if (!Take_(index, task))
+            {
+                std::unique_lock<std::mutex> lock{ m_mutex };
+                m_wake_workers.wait(lock, [this] { return m_stopping || m_queued > 0; });
+                if (m_queued == 0)
+                    return;
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                --m_queued;
+            }
+
+            auto error = std::exception_ptr{};
+            try
+            {
+                task();
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            if (error && !m_error)
+                m_error = error;
+            if (--m_pending == 0)
+                m_all_done.notify_all();
+        }
+    }
+
+private:
+    inline static thread_local const ThreadPool* t_pool = nullptr; // Pool of the calling worker, if any
+    inline static thread_local std::size_t t_worker = 0;            // Index of the calling worker in t_pool
+
+    std::vector<std::thread> m_workers{};
+    std::unique_ptr<Queue[]> m_queues{};
+    std::size_t m_queue_count{}; // One per worker, set before any worker starts
+    std::atomic<std::size_t> m_next_queue{}; // Queue of the next task submitted from outside
+    std::mutex m_mutex{};
+    std::condition_variable m_wake_workers{};
+    std::condition_variable m_all_done{};
+    std::size_t m_queued{};  // Tasks in the queues
+    std::size_t m_pending{}; // Submitted tasks not finished yet
+    std::exception_ptr m_error{};
+    bool m_stopping{};
+};
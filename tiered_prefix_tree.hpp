@@ -0,0 +1,251 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "flat_prefix_tree.hpp"
+#include "prefix_tree.hpp"
+
+/**
+ * Thread-safe Prefix Tree (Trie) made of a frozen base and a mutable delta, as in a log-structured merge tree. \n
+ * \n
+ * Most keys live in a FlatPrefixTree base, compact and fast to read, which is never modified. Writes go to a
+ * small PrefixTree delta: inserted keys with their information, and erased keys as tombstones. Lookups check
+ * the delta first, and only fall back to the base for keys the delta knows nothing about. \n
+ * `Compact` folds the delta into a new base. The delta is first frozen and replaced by an empty one, then the
+ * new base is built from the old base and the frozen delta without holding any lock, and finally swapped in.
+ * Readers and writers are only blocked during the two swaps, which just move pointers, and keep reading the
+ * frozen delta meanwhile. \n
+ * With a compaction threshold, a background thread compacts whenever the delta reaches that many entries.
+ * @tparam EdgeType Refer to PrefixTree.
+ * @tparam NodeInfo Refer to PrefixTree. Lookups return copies of it.
+ */
+template <typename EdgeType, typename NodeInfo>
+class TieredPrefixTree
+{
+public:
+    using Key = std::vector<EdgeType>;
+    using Base = FlatPrefixTree<EdgeType, NodeInfo>;
+
+    /**
+     * Creates a Trie over `base`.
+     * @param base Initial keys.
+     * @param compaction_threshold Delta entries that trigger a background compaction. Zero disables it.
+     */
+    explicit TieredPrefixTree(Base base = Base{}, std::size_t compaction_threshold = 0)
+        : m_base{ std::make_shared<const Base>(std::move(base)) }, m_size{ m_base->Size() },
+          m_compaction_threshold{ compaction_threshold }
+    {
+    }
+
+    TieredPrefixTree(const TieredPrefixTree&) = delete;
+    TieredPrefixTree& operator=(const TieredPrefixTree&) = delete;
+
+    /**
+     * Waits for a running background compaction.
+     */
+    ~TieredPrefixTree()
+    {
+        std::lock_guard<std::mutex> lock{ m_compactor_mutex };
+        if (m_compactor.joinable())
+            m_compactor.join();
+    }
+
+    /**
+     * Inserts or overwrites a key in the delta. Refer to `PrefixTree::Insert`.
+     */
+    auto Insert(const Key& key, NodeInfo info) -> void
+    {
+        {
+            std::unique_lock<std::shared_mutex> lock{ m_mutex };
+            if (!Contains_(key))
+                ++m_size;
+            m_delta.Insert(key, Entry{ std::move(info) });
+        }
+        CompactInBackgroundIfNeeded_();
+    }
+
+    /**
+     * Erases a key, leaving a tombstone in the delta. Throws if it is not present.
+     */
+    auto Erase(const Key& key) -> void
+    {
+        {
+            std::unique_lock<std::shared_mutex> lock{ m_mutex };
+            if (!Contains_(key))
+                throw std::runtime_error("Erasing key not present in Trie");
+            --m_size;
+            m_delta.Insert(key, Entry{ tl::nullopt });
+        }
+        CompactInBackgroundIfNeeded_();
+    }
+
+    /**
+     * Returns a copy of the information associated with `key`, or tl::nullopt.
+     */
+    auto Get(const Key& key) const -> tl::optional<NodeInfo>
+    {
+        std::shared_lock<std::shared_mutex> lock{ m_mutex };
+        for (const Delta* delta : { &m_delta, m_frozen.get() })
+        {
+            if (!delta)
+                continue;
+            auto entry = delta->Get(key);
+            if (entry)
+                return entry->m_info;
+        }
+        auto info = m_base->Get(key);
+        if (!info)
+            return tl::nullopt;
+        return info.value();
+    }
+
+    /**
+     * Returns true if `key` is present.
+     */
+    auto Contains(const Key& key) const -> bool
+    {
+        std::shared_lock<std::shared_mutex> lock{ m_mutex };
+        return Contains_(key);
+    }
+
+    /**
+     * Returns the number of keys.
+     */
+    auto Size() const -> std::size_t
+    {
+        std::shared_lock<std::shared_mutex> lock{ m_mutex };
+        return m_size;
+    }
+
+    /**
+     * Returns true if the Trie holds no keys.
+     */
+    auto Empty() const -> bool { return Size() == 0; }
+
+    /**
+     * Returns the number of entries, tombstones included, written to the delta since the last compaction.
+     */
+    auto DeltaSize() const -> std::size_t
+    {
+        std::shared_lock<std::shared_mutex> lock{ m_mutex };
+        return m_delta.Size();
+    }
+
+    /**
+     * Folds the delta into a new base, on the calling thread. Refer to the class comment.
+     */
+    auto Compact() -> void
+    {
+        std::lock_guard<std::mutex> compaction_lock{ m_compaction_mutex };
+        std::shared_ptr<const Delta> frozen;
+        std::shared_ptr<const Base> base;
+        {
+            std::unique_lock<std::shared_mutex> lock{ m_mutex };
+            if (m_delta.Empty())
+                return;
+            m_frozen = std::make_shared<const Delta>(std::exchange(m_delta, Delta{}));
+            frozen = m_frozen;
+            base = m_base;
+        }
+
+        auto compacted = std::make_shared<const Base>(Merge_(*base, *frozen));
+
+        std::unique_lock<std::shared_mutex> lock{ m_mutex };
+        m_base = std::move(compacted);
+        m_frozen = nullptr;
+    }
+
+private:
+    struct Entry
+    {
+        tl::optional<NodeInfo> m_info; // tl::nullopt marks an erased key
+    };
+    using Delta = PrefixTree<EdgeType, Entry>;
+
+    /**
+     * REQUIRES: m_mutex is held.
+     */
+    auto Contains_(const Key& key) const -> bool
+    {
+        for (const Delta* delta : { &m_delta, m_frozen.get() })
+        {
+            if (!delta)
+                continue;
+            auto entry = delta->Get(key);
+            if (entry)
+                return entry->m_info.has_value();
+        }
+        return m_base->Contains(key);
+    }
+
+    /**
+     * Returns a base with the keys of `base`, updated by `delta`. Both are walked once, in key order.
+     */
+    static auto Merge_(const Base& base, const Delta& delta) -> Base
+    {
+        auto changes = std::vector<std::pair<Key, const Entry*>>{};
+        changes.reserve(delta.Size());
+        delta.ForEach([&changes](const Key& key, const Entry& entry) {
+            changes.emplace_back(key, &entry);
+        });
+
+        auto entries = std::vector<std::pair<Key, NodeInfo>>{};
+        entries.reserve(base.Size() + changes.size());
+        std::size_t next = 0;
+        auto apply_change = [&]() {
+            const auto& [key, entry] = changes[next++];
+            if (entry->m_info)
+                entries.emplace_back(key, entry->m_info.value());
+        };
+        base.ForEach([&](const Key& key, const NodeInfo& info) {
+            while (next < changes.size() && changes[next].first < key)
+                apply_change();
+            if (next < changes.size() && changes[next].first == key)
+                apply_change();
+            else
+                entries.emplace_back(key, info);
+        });
+        while (next < changes.size())
+            apply_change();
+        return Base{ std::move(entries) };
+    }
+
+    /**
+     * Starts a background compaction if the delta reached the threshold and none is running.
+     */
+    auto CompactInBackgroundIfNeeded_() -> void
+    {
+        if (m_compaction_threshold == 0 || DeltaSize() < m_compaction_threshold)
+            return;
+        if (m_compacting.exchange(true))
+            return;
+        std::lock_guard<std::mutex> lock{ m_compactor_mutex };
+        if (m_compactor.joinable())
+            m_compactor.join();
+        m_compactor = std::thread{ [this] {
+            Compact();
+            m_compacting = false;
+        } };
+    }
+
+private:
+    mutable std::shared_mutex m_mutex{}; // Guards the pointers below and the delta
+    Delta m_delta{};
+    std::shared_ptr<const Delta> m_frozen{}; // Delta being compacted, if any
+    std::shared_ptr<const Base> m_base;
+    std::size_t m_size;
+
+    std::size_t m_compaction_threshold;
+    std::mutex m_compaction_mutex{}; // Serializes compactions
+    std::atomic<bool> m_compacting{ false };
+    std::mutex m_compactor_mutex{};
+    std::thread m_compactor{};
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "prefix_tree.hpp"
+
+namespace join_detail
+{
+    /**
+     * Visits every key below the current position of `cursor`, in increasing order. `key` holds the path to
+     * that position. The cursor is left where it was.
+     */
+    template <typename Cursor, typename Key, typename Callback>
+    auto ForEachBelow(Cursor& cursor, Key& key, Callback&& callback) -> void
+    {
+        auto info = cursor.Info();
+        if (info)
+            callback(key, info.value());
+
+        cursor.Open();
+        for (; !cursor.AtEnd(); cursor.Next())
+        {
+            key.push_back(cursor.Key());
+            ForEachBelow(cursor, key, callback);
+            key.pop_back();
+        }
+        cursor.Up();
+    }
+
+    /**
+     * Returns true if some key lies below the current position of `cursor`. Stops at the first one found.
+     */
+    template <typename Cursor>
+    auto AnyBelow(Cursor& cursor) -> bool
+    {
+        if (cursor.Info())
+            return true;
+
+        auto found = false;
+        cursor.Open();
+        for (; !found && !cursor.AtEnd(); cursor.Next())
+            found = AnyBelow(cursor);
+        cursor.Up();
+        return found;
+    }
+
+    /**
+     * Walks two cursors down together over their common edges until `depth`, calling `on_match(key)` with
+     * both cursors positioned on every common prefix of length `depth`. Mismatching edges are skipped with
+     * `Seek`, so subtrees missing on one side are never visited.
+     */
+    template <typename LeftCursor, typename RightCursor, typename Key, typename OnMatch>
+    auto WalkCommon(LeftCursor& left, RightCursor& right, std::size_t depth, Key& key, OnMatch& on_match) -> void
+    {
+        if (key.size() == depth)
+        {
+            on_match(key);
+            return;
+        }
+
+        left.Open();
+        right.Open();
+        while (!left.AtEnd() && !right.AtEnd())
+        {
+            if (left.Key() < right.Key())
+            {
+                left.Seek(right.Key());
+            }
+            else if (right.Key() < left.Key())
+            {
+                right.Seek(left.Key());
+            }
+            else
+            {
+                key.push_back(left.Key());
+                WalkCommon(left, right, depth, key, on_match);
+                key.pop_back();
+                left.Next();
+                right.Next();
+            }
+        }
+        left.Up();
+        right.Up();
+    }
+} // namespace join_detail
+
+/**
+ * Sort-merge equi-join of two Tries on their first `depth` edges. \n
+ * \n
+ * Both Tries are walked together down to `depth`, skipping edges missing on either side, and for every common
+ * prefix the cross product of the two subtrees below it is emitted. Since the Tries are already sorted, no
+ * hashing and no intermediate result is needed. Keys shorter than `depth` do not take part in the join. \n
+ * Pairs are visited in increasing order of left key, then right key.
+ * @param left Left relation.
+ * @param right Right relation. It may store a different kind of information than `left`.
+ * @param depth Number of leading edges both keys must share.
+ * @param callback Called as `callback(const Key& left_key, const LeftInfo&, const Key& right_key,
+ * const RightInfo&)` for every matching pair.
+ */
+template <typename EdgeType, typename LeftInfo, typename LeftReducer, typename RightInfo, typename RightReducer,
+          typename Callback>
+auto Join(const PrefixTree<EdgeType, LeftInfo, LeftReducer>& left,
+          const PrefixTree<EdgeType, RightInfo, RightReducer>& right, std::size_t depth, Callback&& callback) -> void
+{
+    auto left_cursor = left.MakeCursor();
+    auto right_cursor = right.MakeCursor();
+    auto prefix = std::vector<EdgeType>{};
+    auto on_match = [&](const std::vector<EdgeType>& common) {
+        auto left_key = common;
+        join_detail::ForEachBelow(left_cursor, left_key, [&](const auto& lhs_key, const LeftInfo& lhs_info) {
+            auto right_key = common;
+            join_detail::ForEachBelow(right_cursor, right_key,
+                                      [&](const auto& rhs_key, const RightInfo& rhs_info) {
+                                          callback(lhs_key, lhs_info, rhs_key, rhs_info);
+                                      });
+        });
+    };
+    join_detail::WalkCommon(left_cursor, right_cursor, depth, prefix, on_match);
+}
+
+/**
+ * Semi-join of two Tries on their first `depth` edges. \n
+ * \n
+ * Visits, in increasing order, every key of `left` whose first `depth` edges are shared by at least one key of
+ * `right`. Each subtree of `right` is only explored until its first key is found.
+ * @param callback Called as `callback(const Key& left_key, const LeftInfo&)`.
+ * Refer to `Join` for the other parameters.
+ */
+template <typename EdgeType, typename LeftInfo, typename LeftReducer, typename RightInfo, typename RightReducer,
+          typename Callback>
+auto SemiJoin(const PrefixTree<EdgeType, LeftInfo, LeftReducer>& left,
+              const PrefixTree<EdgeType, RightInfo, RightReducer>& right, std::size_t depth, Callback&& callback)
+    -> void
+{
+    auto left_cursor = left.MakeCursor();
+    auto right_cursor = right.MakeCursor();
+    auto prefix = std::vector<EdgeType>{};
+    auto on_match = [&](const std::vector<EdgeType>& common) {
+        if (!join_detail::AnyBelow(right_cursor))
+            return;
+        auto left_key = common;
+        join_detail::ForEachBelow(left_cursor, left_key, callback);
+    };
+    join_detail::WalkCommon(left_cursor, right_cursor, depth, prefix, on_match);
+}